@@ -0,0 +1,224 @@
+// Micro-benchmark of the geometry kernels. Built together with the library sources to reach its static
+// functions: make bench && ./bench [outline files ...]
+// Every polygon kernel runs in its scalar form over Polygon2 and its form over PolygonEdges on the same
+// queries, the answers have to agree.
+
+#include "leafer.c"
+
+#define BENCH_MIN_SECONDS 0.02 // each measurement repeats its batch at least this long
+#define BENCH_SEED 42
+#define BENCH_RADIUS 300.0f
+#define BENCH_DIST_EPS 1e-3f   // distances agree up to float rounding of the two formulas
+
+static const size_t bench_edges[] = {16, 64, 256, 1024, 4096};
+static const size_t bench_batches[] = {64, 1024, 16384};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef struct Segment {
+    Vector2 a;
+    Vector2 b;
+} Segment;
+
+typedef struct Queries {
+    Vector2 *points;
+    Segment *segments;
+    size_t count;
+} Queries;
+
+// Written by every kernel so the loops can't be dropped
+static volatile float bench_sink;
+static size_t bench_mismatches;
+
+// Serrated ellipse, roughly what gets drawn in the window
+static void leaf_outline(Polygon2 *polygon, size_t n) {
+    polygon->count = 0;
+    for (size_t i = 0; i < n; i++) {
+        float angle = 2 * (float)M_PI * i / n;
+        float r = BENCH_RADIUS * (1 + 0.05f * sinf(angle * (float)(n / 8)));
+        DA_APPEND(polygon, ((Vector2){0.6f * r * cosf(angle), r * sinf(angle)}));
+    }
+    polygon->closed = true;
+}
+
+// Star with random spikes, concave almost everywhere
+static void star_outline(Polygon2 *polygon, size_t n, Rng *rng) {
+    polygon->count = 0;
+    for (size_t i = 0; i < n; i++) {
+        float angle = 2 * (float)M_PI * i / n;
+        float r = BENCH_RADIUS * (0.3f + 0.7f * random_float(rng));
+        DA_APPEND(polygon, ((Vector2){r * cosf(angle), r * sinf(angle)}));
+    }
+    polygon->closed = true;
+}
+
+static Vector2 random_point(Rng *rng, float min_x, float min_y, float max_x, float max_y) {
+    return (Vector2){min_x + (max_x - min_x) * random_float(rng), min_y + (max_y - min_y) * random_float(rng)};
+}
+
+// Points all over the bounding box grown by a tenth, segments short as vein links or long as outline
+// edges, every eighth one starting at a vertex of the polygon
+static void make_queries(Queries *queries, const Polygon2 *polygon, size_t count, Rng *rng) {
+    float min_x = __FLT_MAX__, min_y = __FLT_MAX__, max_x = -__FLT_MAX__, max_y = -__FLT_MAX__;
+    for (size_t i = 0; i < polygon->count; i++) {
+        min_x = fminf(min_x, polygon->items[i].x);
+        min_y = fminf(min_y, polygon->items[i].y);
+        max_x = fmaxf(max_x, polygon->items[i].x);
+        max_y = fmaxf(max_y, polygon->items[i].y);
+    }
+    float margin_x = 0.1f * (max_x - min_x), margin_y = 0.1f * (max_y - min_y);
+    min_x -= margin_x; max_x += margin_x;
+    min_y -= margin_y; max_y += margin_y;
+
+    queries->points = realloc(queries->points, sizeof(*queries->points) * count);
+    queries->segments = realloc(queries->segments, sizeof(*queries->segments) * count);
+    assert(queries->points && queries->segments && "make_queries: realloc failed");
+    queries->count = count;
+    for (size_t i = 0; i < count; i++) {
+        queries->points[i] = random_point(rng, min_x, min_y, max_x, max_y);
+        Vector2 a = i % 8 == 0 ? polygon->items[random_next(rng) % polygon->count] : random_point(rng, min_x, min_y, max_x, max_y);
+        float length = (i % 2 ? 2 * VEIN_RADIUS : 0.5f * (max_x - min_x)) * random_float(rng);
+        float angle = 2 * (float)M_PI * random_float(rng);
+        queries->segments[i] = (Segment){a, {a.x + length * cosf(angle), a.y + length * sinf(angle)}};
+    }
+}
+
+typedef struct Bench {
+    const char *kernel;
+    const char *shape;
+    size_t edges;
+    size_t batch;
+    double seconds;
+    size_t ops;
+} Bench;
+
+static void bench_report(const Bench *bench) {
+    double ns = bench->seconds * 1e9 / bench->ops;
+    // Polygon kernels look at every edge, their throughput is in edges
+    double items = bench->edges > 0 ? (double)bench->ops * bench->edges : (double)bench->ops;
+    printf("%-26s %-8s %6zu %7zu %12.2f %12.2f\n", bench->kernel, bench->shape, bench->edges, bench->batch, ns,
+           items / bench->seconds / 1e6);
+}
+
+// Runs the kernel over the whole batch until the time is long enough to trust
+#define BENCH(bench, body)                                                     \
+    do {                                                                       \
+        size_t rounds = 0;                                                     \
+        double start = leafer_now();                                           \
+        double elapsed;                                                        \
+        do {                                                                   \
+            for (size_t q = 0; q < (bench)->batch; q++) { body; }              \
+            rounds++;                                                          \
+            elapsed = leafer_now() - start;                                    \
+        } while (elapsed < BENCH_MIN_SECONDS);                                 \
+        (bench)->seconds = elapsed;                                            \
+        (bench)->ops = rounds * (bench)->batch;                                \
+        bench_report(bench);                                                   \
+    } while (0)
+
+static void check(bool same, const char *what, const char *shape, size_t edges, size_t q) {
+    if (same) return;
+    if (bench_mismatches++ < 10) printf("Mismatch: %s on %s with %zu edges, query %zu\n", what, shape, edges, q);
+}
+
+static void verify_polygon(const Polygon2 *polygon, const PolygonEdges *edges, const Queries *queries, const char *shape) {
+    for (size_t q = 0; q < queries->count; q++) {
+        Vector2 p = queries->points[q];
+        float scalar_dist, edges_dist;
+        bool scalar_inside = point_inside(p, polygon, &scalar_dist);
+        bool edges_inside = edges_point_inside(edges, p, &edges_dist);
+        check(scalar_inside == edges_inside, "point_inside", shape, polygon->count, q);
+        check(fabsf(scalar_dist - edges_dist) <= BENCH_DIST_EPS * fmaxf(1, scalar_dist), "min_dist", shape, polygon->count, q);
+        check(fabsf(scalar_dist - edges_distance(edges, p)) <= BENCH_DIST_EPS * fmaxf(1, scalar_dist), "edges_distance", shape, polygon->count, q);
+
+        Segment s = queries->segments[q];
+        check(segment_intersect_polygon(s.a, s.b, polygon) == edges_cross_segment(edges, s.a, s.b), "segment_intersect_polygon", shape, polygon->count, q);
+    }
+}
+
+static void bench_polygon(const Polygon2 *polygon, const char *shape, Queries *queries, Rng *rng) {
+    PolygonEdges edges = (PolygonEdges){0};
+    polygon_edges_build(&edges, polygon);
+    size_t n = polygon->count;
+
+    make_queries(queries, polygon, bench_batches[ARRAY_LEN(bench_batches) - 1], rng);
+    verify_polygon(polygon, &edges, queries, shape);
+
+    for (size_t b = 0; b < ARRAY_LEN(bench_batches); b++) {
+        const Vector2 *points = queries->points;
+        const Segment *segments = queries->segments;
+        Bench bench = {.shape=shape, .edges=n, .batch=bench_batches[b]};
+        float dist;
+
+        bench.kernel = "point_inside";
+        BENCH(&bench, bench_sink = point_inside(points[q], polygon, &dist) + dist);
+        bench.kernel = "edges_point_inside";
+        BENCH(&bench, bench_sink = edges_point_inside(&edges, points[q], &dist) + dist);
+        bench.kernel = "closest_edge";
+        BENCH(&bench, {
+            float best = __FLT_MAX__;
+            for (size_t i = 0; i < n; i++) best = fminf(best, distance_v2(polygon->items[i], polygon->items[(i + 1) % n], points[q], true));
+            bench_sink = best;
+        });
+        bench.kernel = "edges_distance";
+        BENCH(&bench, bench_sink = edges_distance(&edges, points[q]));
+        bench.kernel = "segment_intersect_polygon";
+        BENCH(&bench, bench_sink = segment_intersect_polygon(segments[q].a, segments[q].b, polygon));
+        bench.kernel = "edges_cross_segment";
+        BENCH(&bench, bench_sink = edges_cross_segment(&edges, segments[q].a, segments[q].b));
+    }
+    polygon_edges_free(&edges);
+}
+
+// Kernels on single pairs of points, segments and vectors
+static void bench_pairs(Queries *queries, Rng *rng) {
+    Polygon2 square = (Polygon2){0};
+    leaf_outline(&square, 4);
+    make_queries(queries, &square, bench_batches[ARRAY_LEN(bench_batches) - 1], rng);
+    free(square.items);
+
+    const Vector2 *points = queries->points;
+    const Segment *segments = queries->segments;
+    size_t last = queries->count - 1;
+    for (size_t b = 0; b < ARRAY_LEN(bench_batches); b++) {
+        Bench bench = {.shape="random", .batch=bench_batches[b]};
+        bench.kernel = "norm_v2";
+        BENCH(&bench, bench_sink = norm_v2(sub_v2(segments[q].b, segments[q].a)).x);
+        bench.kernel = "distance_v2";
+        BENCH(&bench, bench_sink = distance_v2(segments[q].a, segments[q].b, points[q], true));
+        bench.kernel = "segments_intersect";
+        BENCH(&bench, bench_sink = segments_intersect(segments[q].a, segments[q].b, segments[last - q].a, segments[last - q].b));
+    }
+}
+
+int main(int argc, char **argv) {
+    Rng rng;
+    random_seed(&rng, BENCH_SEED);
+    Queries queries = (Queries){0};
+    Polygon2 polygon = (Polygon2){0};
+
+    printf("%-26s %-8s %6s %7s %12s %12s\n", "kernel", "outline", "edges", "batch", "ns/op", "M items/s");
+    bench_pairs(&queries, &rng);
+    for (size_t e = 0; e < ARRAY_LEN(bench_edges); e++) {
+        leaf_outline(&polygon, bench_edges[e]);
+        bench_polygon(&polygon, "leaf", &queries, &rng);
+        star_outline(&polygon, bench_edges[e], &rng);
+        bench_polygon(&polygon, "star", &queries, &rng);
+    }
+    // Outlines saved by the window, as they are
+    for (int i = 1; i < argc; i++) {
+        if (!read_polygon_file(&polygon, argv[i])) return 1;
+        polygon.closed = true;
+        bench_polygon(&polygon, "file", &queries, &rng);
+    }
+
+    free(polygon.items);
+    free(queries.points);
+    free(queries.segments);
+    if (bench_mismatches > 0) {
+        printf("%zu mismatches between scalar and edge kernels\n", bench_mismatches);
+        return 1;
+    }
+    printf("Scalar and edge kernels agree\n");
+    return 0;
+}
@@ -0,0 +1,4129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "leafer.h"
+
+// Rest of the raylib types used here, raylib itself is never included
+typedef struct Vector3 {
+    float x;
+    float y;
+    float z;
+} Vector3;
+
+typedef struct Rectangle {
+    float x;
+    float y;
+    float width;
+    float height;
+} Rectangle;
+
+#define CONVERGE_STEPS 8 // steps in a row without anything new before the growth is over
+
+#define MIN_POLYGON_DIST 10.0f
+#define MIN_POLYGON_LEN 3.0f
+#define SMOOTH_TOLERANCE 0.25f // how far smoothed veins may stray from their limit curve
+#define SIMPLIFY_VEINS 1.0f     // smallest triangle a point of a smoothed vein has to span to stay, 0 keeps all
+#define SIMPLIFY_OUTLINE 0.0f   // same for the drawn or imported outline
+
+#define VEIN_RADIUS 10.0f
+#define VEIN_RADIUS_MIN 3.0f
+#define TOLERATION_RATIO 0.9f
+// Generation ratio is used to calculate the reduction in node radius
+// hense starting with some relatively big number
+#define GEN_START 50
+
+#define AUXIN_RADIUS 10.0f
+#define AUXIN_DOT_RADIUS 2.0f
+#define AUXIN_SPRAY_THRESHOLD 100
+#define FREE_CELL_RATIO (1.0f / 3) // free space cells to the auxin radius, half their diagonal stays under a quarter of it
+#define SCRATCH_WARMUP_STEPS 4 // growth steps after which scratch memory must not grow anymore
+#define STEP_SLICE 64         // auxins handled between two looks at the clock
+#define SPRAY_CHUNK 16       // candidates drawn from one random stream, whichever thread draws them
+#define SPRAY_PARALLEL_MIN 8 // chunks worth waking up helper threads for, fewer when the threshold asks for fewer
+#define SPRAY_HELPERS_MAX 63
+#define AUXIN_COMPACT_MIN 256 // auxin slots are compacted once more than half of at least this many are free
+
+// Marginal growth: blade starts at a fraction of the drawn outline and expands by a rate per step
+#define BLADE_GROWTH_RATE  0.0f
+#define BLADE_GROWTH_START 0.5f
+
+// Out-of-core growth: the world is split into square tiles, quiet tiles get written out to a spill
+// file and their nodes leave memory once nothing around them can grow anymore
+#define TILE_SIZE          256.0f
+#define TILE_QUIET_STEPS   64  // steps without live auxins or new nodes before a tile is finalised
+#define TILE_FLUSH_STEPS   16
+
+#define LEAF_VEIN_THCK_START 1.0f
+#define LEAF_VEIN_THCK_END   6.0f
+#define LEAF_VEIN_MURRAY_EXP 3.0f // radius^exp of a vein is the sum of the ones of its children
+
+#define DA_APPEND(da, item)                                                    \
+    do {                                                                       \
+        if ((da)->capacity <= (da)->count) {                                   \
+            if ((da)->capacity == 0) (da)->capacity = 16;                      \
+            else (da)->capacity *= 2;                                          \
+            (da)->items = realloc((da)->items, sizeof(*(da)->items) * (da)->capacity); \
+            assert((da)->items && "DA_APPEND: realloc failed");                \
+        }                                                                      \
+        (da)->items[(da)->count++] = (item);                                   \
+    } while (0)
+
+typedef struct Polygon2 {
+    Vector2 *items;
+    size_t count;
+    size_t capacity;
+    bool closed;
+} Polygon2;
+
+typedef struct Indeces {
+    size_t *items;
+    size_t count;
+    size_t capacity;
+} Indeces;
+
+typedef struct Bytes {
+    uint8_t *items;
+    size_t count;
+    size_t capacity;
+} Bytes;
+
+typedef struct Node {
+    Vector2 center;
+    float radius;
+    Indeces closest_source_indeces; // slice of the step's scratch memory, not owned by the node
+    Vector2 parent;
+    size_t gen;
+} Node;
+
+typedef struct Veins {
+    Node *items;
+    size_t count;
+    size_t capacity;
+} Veins;
+
+typedef struct Source {
+    Vector2 center;
+    float radius;
+    size_t closest_node_index;
+    size_t piece;
+    size_t born; // step it was sprayed in
+} Source;
+
+// Auxins stay in their slots until compaction, so their indeces can be kept across steps.
+// Removed slots are cleared in the `alive` mask and reused from the free list.
+typedef struct Auxins {
+    Source *items;
+    size_t count; // slots, alive or not
+    size_t capacity;
+    uint64_t *alive;
+    size_t alive_words;
+    size_t alive_count;
+    Indeces free;
+} Auxins;
+
+#define NO_PIECE SIZE_MAX
+
+// Convex part of the blade, everything inside of it sees each other
+typedef struct Piece {
+    Indeces points;    // outline indeces in the winding of the outline
+    Indeces diagonals; // shared with neighbouring pieces
+} Piece;
+
+typedef struct Pieces {
+    Piece *items;
+    size_t count;
+    size_t capacity;
+} Pieces;
+
+// Diagonal of the outline that separates two pieces
+typedef struct Diagonal {
+    size_t a, b;
+    size_t pieces[2];
+} Diagonal;
+
+typedef struct Diagonals {
+    Diagonal *items;
+    size_t count;
+    size_t capacity;
+} Diagonals;
+
+typedef struct Decomposition {
+    Pieces pieces;
+    Diagonals diagonals;
+    int winding; // of the outline, pieces go the same way
+} Decomposition;
+
+// Edges of a closed polygon laid out field by field for the queries of the growth. Points are repeated with
+// the first one once more at the end, so edge i always goes from point i to point i + 1.
+typedef struct PolygonEdges {
+    float *x, *y;   // count + 1 points
+    float *dx, *dy; // to the next point
+    float *inv_len_sq; // 0 for a zero length edge
+    float *min_x, *min_y, *max_x, *max_y;
+    size_t count;
+} PolygonEdges;
+
+// Leaf as indexed geometry ready to be uploaded as is
+typedef struct MeshVertex {
+    Vector3 position;
+    Vector2 uv;
+    Color color;
+} MeshVertex;
+
+typedef struct MeshVertices {
+    MeshVertex *items;
+    size_t count;
+    size_t capacity;
+} MeshVertices;
+
+typedef struct MeshIndices {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} MeshIndices;
+
+typedef struct LeafMesh {
+    MeshVertices vertices;
+    MeshIndices indices;
+} LeafMesh;
+
+#define DEFAULT_PARAMS (LeaferParams){                                               \
+        .vein_radius           = VEIN_RADIUS,                                  \
+        .vein_radius_min       = VEIN_RADIUS_MIN,                              \
+        .toleration_ratio      = TOLERATION_RATIO,                             \
+        .auxin_radius          = AUXIN_RADIUS,                                 \
+        .auxin_spray_threshold = AUXIN_SPRAY_THRESHOLD,                        \
+        .converge_steps        = CONVERGE_STEPS,                               \
+        .growth_rate           = BLADE_GROWTH_RATE,                            \
+        .growth_start          = BLADE_GROWTH_START,                           \
+        .tile_size             = TILE_SIZE,                                    \
+        .simplify_veins        = SIMPLIFY_VEINS,                               \
+        .simplify_outline      = SIMPLIFY_OUTLINE,                             \
+    }
+
+// Uniform grid of vein node indeces. Cells are laid out in blade coordinates, the ones the
+// drawn outline has at full size, so expanding the blade only changes `scale`: nodes never
+// have to be moved between cells.
+typedef struct NodeGrid {
+    Vector2 origin;  // world point the blade expands from
+    float scale;     // world = origin + blade * scale
+    Vector2 min;     // blade coordinates of the first cell corner
+    float cell_size; // in blade units
+    int cols;
+    int rows;
+    Indeces *cells;
+} NodeGrid;
+
+typedef enum TileState {
+    TILE_ACTIVE,
+    TILE_FINALISING, // being written out right now
+    TILE_FINALISED,
+} TileState;
+
+typedef struct Tile {
+    size_t last_busy; // last step with live auxins or new nodes in the tile
+    TileState state;
+} Tile;
+
+typedef struct Tiling {
+    FILE *spill;    // NULL when the whole leaf stays in memory
+    Vector2 min;
+    float size;
+    int cols;
+    int rows;
+    Tile *items;
+    Indeces active; // tiles auxins are still sprayed into
+    size_t spilled; // nodes written to the spill file so far
+} Tiling;
+
+// xoshiro256** state
+typedef struct Rng {
+    uint64_t s[4];
+} Rng;
+
+// Auxin density over the blade's bounding box: cells of a grayscale map drawn with Vose's alias method,
+// a cell keeps itself with probability `prob` and hands over to `alias` otherwise
+typedef struct Density {
+    float *prob;
+    uint32_t *alias;
+    size_t count; // cells, 0 for uniform spraying
+    int cols;
+    int rows;
+} Density;
+
+// Coarse cells of the bounds auxins can still survive in. Every cell is either wholly inside the blade or so
+// close to the outline that auxins die there anyway. A cell is done for once each of its corners is within
+// the auxin radius of a node that sees it, only gaps smaller than a cell between the nodes' reach are missed.
+// Nodes neither move nor go away meanwhile, cells only ever get dropped.
+typedef struct FreeSpace {
+    Vector2 min;
+    float cell_size;
+    int cols;
+    int rows;
+    uint8_t *corners; // (cols + 1) * (rows + 1), 1 once covered
+    uint32_t *slots;  // position of every cell in `cells`, FREE_NONE once dropped. NULL while not tracked
+    uint32_t *cells;  // free ones in no particular order
+    size_t count;
+} FreeSpace;
+
+#define FREE_NONE UINT32_MAX
+
+// Candidates of one spray chunk, kept in the order they were drawn
+typedef struct SprayChunk {
+    Rng rng;
+    size_t count;
+    Source found[SPRAY_CHUNK];
+} SprayChunk;
+
+// One round of spraying, chunks are handed out to threads one by one
+typedef struct Spray {
+    SprayChunk *chunks;
+    size_t count;
+    atomic_size_t next;
+    const PolygonEdges *edges;
+    const LeaferParams *params;
+    Rectangle bounds;
+    const Tiling *tiling;
+    const Decomposition *decomposition;
+    const Density *density;
+    const FreeSpace *free_space;
+    size_t step;
+} Spray;
+
+// Helper threads of the spraying, started once and woken for every round big enough for them
+typedef struct SprayPool {
+    pthread_t threads[SPRAY_HELPERS_MAX];
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    Spray *spray; // round being drawn
+    size_t round; // bumped for every round
+    size_t busy;  // helpers still drawing it
+    bool quit;
+} SprayPool;
+
+typedef struct ScratchBlock {
+    struct ScratchBlock *next;
+    max_align_t data[];
+} ScratchBlock;
+
+// Temporary memory of a growth step, everything is released at once by a reset.
+// Requests that don't fit go to the heap and the block grows to cover all of them on the next reset.
+typedef struct Scratch {
+    uint8_t *base;
+    size_t used;
+    size_t capacity;
+    size_t wanted; // bytes requested since the last reset, fitting or not
+    ScratchBlock *overflow;
+    size_t heap_allocs; // debug counter, stays put once the scratch is warm
+} Scratch;
+
+// Stage of the step in progress, each runs after the previous one is complete
+typedef enum StepStage {
+    STEP_SPRAY,
+    STEP_ELIMINATE,
+    STEP_ASSOCIATE,
+    STEP_PRODUCE,
+} StepStage;
+
+// Complete state of a single leaf growth, simulations share nothing with each other
+struct Leafer {
+    LeaferParams params;
+    Polygon2 polygon;
+    Polygon2 outline; // polygon as it was drawn, the blade reaches it at scale 1
+    Veins veins;
+    Indeces node_pieces; // convex piece of the blade every node lies in, NO_PIECE if on its border. Kept out of
+                         // `Node` so veins files keep their layout
+    Auxins auxins;
+    NodeGrid grid;
+    Vector2 origin;
+    float scale;
+    Rng rng;
+    size_t threads; // spraying helpers, results are the same for any number of them
+    SprayPool pool; // threads - 1 helpers, started by the first round that needs them
+    Rectangle bounds; // auxins are sprayed over the blade's bounding box
+    Density density;  // stretched over the bounds
+    FreeSpace free_space; // tracked once the blade is at full size
+    Tiling tiling;
+    Decomposition decomposition; // of the outline, follows the blade while it expands as it's made of outline indeces
+    PolygonEdges edges;          // of the blade, rebuilt whenever it changes
+    Scratch scratch;
+    size_t step;
+    size_t gen;
+    // Step in progress, it can be left at any stage and picked up later
+    StepStage stage;
+    size_t cursor; // next auxin slot of the stage
+    size_t sprayed;
+    size_t uncovered;
+    size_t heap_allocs;
+    // Growth is over once it stays quiet: no new nodes and no new auxins that survive their first step
+    size_t quiet_steps;
+    size_t quiet_sprayed;
+    size_t quiet_covered;     // sprayed where a node already is
+    size_t quiet_unreachable; // sprayed where no node can see them
+    LeaferStop stop;
+};
+
+static bool write_polygon_file(const Polygon2 *polygon, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "wb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    if (fwrite(&polygon->count, sizeof(polygon->count), 1, file_desc) != 1) {
+        printf("Can't write amount of polygon points to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fwrite(polygon->items, sizeof(Vector2), polygon->count, file_desc) != polygon->count) {
+        printf("Can't write a polygon points to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    printf("Polygon saved to file: %s\n", file_name);
+    return true;
+}
+
+// Bytes from the current position to the end of the file, -1 if they can't be told
+static long file_remaining(FILE *file_desc) {
+    long position = ftell(file_desc);
+    if (position < 0 || fseek(file_desc, 0, SEEK_END) != 0) return -1;
+    long end = ftell(file_desc);
+    if (fseek(file_desc, position, SEEK_SET) != 0) return -1;
+    return end - position;
+}
+
+static bool read_polygon_file(Polygon2 *polygon, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "rb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    if (fread(&polygon->count, sizeof(polygon->count), 1, file_desc) != 1) {
+        printf("Can't read number of a polygon points from file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    // Count comes from the file, it can't promise more than the file holds
+    long remaining = file_remaining(file_desc);
+    if (remaining < 0 || polygon->count > (size_t)remaining / sizeof(Vector2)) {
+        printf("Can't read polygon points from file: %s\n", file_name);
+        polygon->count = 0;
+        fclose(file_desc);
+        return false;
+    }
+    polygon->capacity = polygon->count;
+    polygon->items = realloc(polygon->items, sizeof(Vector2) * (polygon->capacity > 0 ? polygon->capacity : 1));
+    assert(polygon->items && "read_polygon_file: realloc failed");
+    if (fread(polygon->items, sizeof(Vector2), polygon->count, file_desc) != polygon->count) {
+        printf("Can't read polygon points from file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    printf("Polygon read from file: %s\n", file_name);
+    return true;
+}
+
+static bool read_veins_file(Veins *veins, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "rb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    if (fread(&veins->count, sizeof(veins->count), 1, file_desc) != 1) {
+        printf("Can't read number of a veins nodes from file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    long remaining = file_remaining(file_desc);
+    if (remaining < 0 || veins->count > (size_t)remaining / sizeof(Node)) {
+        printf("Can't read veins nodes from file: %s\n", file_name);
+        veins->count = 0;
+        fclose(file_desc);
+        return false;
+    }
+    veins->capacity = veins->count;
+    veins->items = realloc(veins->items, sizeof(Node) * (veins->capacity > 0 ? veins->capacity : 1));
+    assert(veins->items && "read_veins_file: realloc failed");
+    if (fread(veins->items, sizeof(Node), veins->count, file_desc) != veins->count) {
+        printf("Can't read veins nodes from file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    // Scratch slices of the growth that wrote them are long gone
+    for (size_t i = 0; i < veins->count; i++) veins->items[i].closest_source_indeces = (Indeces){0};
+    printf("Veins read from file: %s\n", file_name);
+    return true;
+}
+
+static bool write_veins_file(const Veins *veins, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "wb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    if (fwrite(&veins->count, sizeof(veins->count), 1, file_desc) != 1) {
+        printf("Can't write amount of veins nodes to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fwrite(veins->items, sizeof(Node), veins->count, file_desc) != veins->count) {
+        printf("Can't write a veins nodes to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    printf("Veins saved to file: %s\n", file_name);
+    return true;
+}
+
+static bool write_vertices_file(const LeaferTriangles *vertices, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "wb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    if (fwrite(&vertices->count, sizeof(vertices->count), 1, file_desc) != 1) {
+        printf("Can't write amount of triangles to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fwrite(vertices->items, sizeof(LeaferTriangle), vertices->count, file_desc) != vertices->count) {
+        printf("Can't write triangles to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    printf("Vertices saved to file: %s\n", file_name);
+    return true;
+}
+
+// SplitMix64, only spreads a seed over the xoshiro state
+static inline uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void random_seed(Rng *rng, uint64_t seed) {
+    for (size_t i = 0; i < 4; i++) rng->s[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rotl64(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+// xoshiro256**: small and fast, each simulation owns its generator so growths don't interfere
+static inline uint64_t random_next(Rng *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return result;
+}
+
+// Independent stream for some piece of work, seeded by the parent that moves on
+static Rng random_split(Rng *rng) {
+    Rng child;
+    random_seed(&child, random_next(rng));
+    return child;
+}
+
+// Uniform in [0, 1)
+static inline float random_float(Rng *rng) {
+    return (float)(random_next(rng) >> 40) * (1.0f / 16777216.0f);
+}
+
+// Random value between min and max (both included), same contract as GetRandomValue
+static inline int random_int(Rng *rng, int min, int max) {
+    return min + (int)(random_next(rng) % (uint64_t)(max - min + 1));
+}
+
+static inline bool same_v2(Vector2 a, Vector2 b) { return a.x == b.x && a.y == b.y; }
+
+static inline Vector2 sub_v2(Vector2 a, Vector2 b) {
+    return (Vector2){a.x - b.x, a.y - b.y};
+}
+
+static inline Vector2 add_v2(Vector2 a, Vector2 b) {
+    return (Vector2){a.x + b.x, a.y + b.y};
+}
+
+static inline Vector2 scale_v2(Vector2 a, float s) {
+    return (Vector2){a.x * s, a.y * s};
+}
+
+static inline float len_v2_sq(Vector2 ab) {
+    return ab.x * ab.x + ab.y * ab.y;
+}
+
+static inline float len_v2(Vector2 ab) {
+    return sqrt(len_v2_sq(ab));
+}
+
+static inline float cross_v2(Vector2 ab, Vector2 ap) {
+    return ab.x * ap.y - ab.y * ap.x;
+}
+
+// Vein color goes from the thinnest veins at 0 to the root one at 1
+static inline float vein_shade(float thickness) {
+    return (thickness - LEAF_VEIN_THCK_START) / (LEAF_VEIN_THCK_END - LEAF_VEIN_THCK_START);
+}
+
+static inline Color lerp_color(Color a, Color b, float p) {
+    return (Color) {
+        (unsigned char)(a.r + (b.r - a.r)*p),
+        (unsigned char)(a.g + (b.g - a.g)*p),
+        (unsigned char)(a.b + (b.b - a.b)*p),
+        (unsigned char)(a.a + (b.a - a.a)*p),
+    };
+}
+
+static Vector2 norm_v2(Vector2 v) {
+    // Calculating on double precision to check for overflow
+    double len = sqrt(v.x * v.x + v.y * v.y);
+    if (fabs(len) > (double)__FLT_MAX__) return (Vector2){0, 0};
+    float inv = 1.0f / len;
+    return (Vector2){v.x * inv, v.y * inv};
+}
+
+// Closest point on a line defined by segment AB to point C, if clampled - strictly on segment
+static Vector2 closest_on_segment(Vector2 a, Vector2 b, Vector2 c, bool clamped) {
+    Vector2 ab = sub_v2(b, a);
+    Vector2 ac = sub_v2(c, a);
+    float t = (ac.x * ab.x + ac.y * ab.y) / len_v2_sq(ab);
+    // clamp
+    if (clamped) t = t < 0 ? 0.0f : (t > 1 ? 1 : t);
+    return (Vector2){a.x + t * ab.x, a.y + t * ab.y};
+}
+
+// Distance from C to a line defined by segment AB, if clampled - strictly to segment
+static float distance_v2(Vector2 a, Vector2 b, Vector2 c, bool clamped) {
+    if (same_v2(a, b)) return len_v2(sub_v2(a, c));
+    return len_v2(sub_v2(c, closest_on_segment(a, b, c, clamped)));
+}
+
+static inline int sign(float x) { return (x > 0) - (x < 0); }
+
+static int orient(Vector2 a, Vector2 b, Vector2 c) {
+    // orientation of triplet (a,b,c): >0 left, <0 right, 0 collinear
+    return sign(cross_v2(sub_v2(b, a), sub_v2(c, a)));
+}
+
+static int on_segment(Vector2 a, Vector2 b, Vector2 p) {
+    // assumes p is collinear with a-b; check bounding box
+    return (p.x >= fminf(a.x, b.x) && p.x <= fmaxf(a.x, b.x)
+         && p.y >= fminf(a.y, b.y) && p.y <= fmaxf(a.y, b.y));
+}
+
+static bool segments_intersect(Vector2 a1, Vector2 a2, Vector2 b1, Vector2 b2) {
+    int o1 = orient(a1, a2, b1); // where b1 relative to A
+    int o2 = orient(a1, a2, b2); // where b2 relative to A
+    int o3 = orient(b1, b2, a1); // where a1 relative to B
+    int o4 = orient(b1, b2, a2); // where a2 relative to B
+
+    if (o1 != o2 && o3 != o4)
+        return true; // proper intersection
+
+    // special collinear cases
+    if (o1 == 0 && on_segment(a1, a2, b1)) return true;
+    if (o2 == 0 && on_segment(a1, a2, b2)) return true;
+    if (o3 == 0 && on_segment(b1, b2, a1)) return true;
+    if (o4 == 0 && on_segment(b1, b2, a2)) return true;
+
+    return false;
+}
+
+static bool segment_intersect_polygon(Vector2 a, Vector2 b, const Polygon2 *polygon) {
+    if (same_v2(a, b)) return false;      // zero lenght segment in
+    if (polygon->count < 2) return false; // no actual segments to test against in the list
+
+    // Skip last edge if polygon not yet closed
+    size_t max_index = polygon->closed ? polygon->count : polygon->count - 1;
+
+    for (size_t i = 0; i < max_index; i++) {
+        Vector2 c = polygon->items[i];
+        Vector2 d = polygon->items[(i + 1) % polygon->count];
+        assert(!same_v2(c, d) && "Leaf contain zero lenght segment");
+        bool a_is_c = same_v2(a, c);
+        bool a_is_d = same_v2(a, d);
+        bool b_is_c = same_v2(b, c);
+        bool b_is_d = same_v2(b, d);
+
+        // Segments fully match
+        if ((a_is_c && b_is_d) || (a_is_d && b_is_c)) continue;
+
+        // Segments are sequential
+        if (a_is_c || a_is_d) {
+            // Test B distance to CD
+            if (distance_v2(c, d, b, true) < MIN_POLYGON_DIST) return true;
+            continue;
+        }
+        if (b_is_c || b_is_d) {
+            // Test A distance to CD
+            if (distance_v2(c, d, a, true) < MIN_POLYGON_DIST) return true;
+            continue;
+        }
+
+        // General case
+        if (segments_intersect(a, b, c, d)) return true;
+    }
+    return false;
+}
+
+static bool point_inside(Vector2 point, const Polygon2 *polygon, float *min_dist) {
+    int winding_number = 0;
+    *min_dist = __FLT_MAX__;
+
+    for (size_t i = 0; i < polygon->count; i++) {
+        Vector2 start = polygon->items[i];
+        Vector2 end = polygon->items[(i + 1) % polygon->count];
+
+        float dist = distance_v2(start, end, point, true);
+        if (*min_dist > dist) *min_dist = dist;
+
+        Vector2 ab = sub_v2(end, start);
+        Vector2 ap = sub_v2(point, start);
+
+        if (start.y <= point.y && end.y > point.y) {
+            if (cross_v2(ab, ap) > 0) winding_number += 1;
+        } else if (start.y > point.y && end.y <= point.y) {
+            if (cross_v2(ab, ap) < 0) winding_number -= 1;
+        }
+    }
+
+    return winding_number != 0;  // Non-zero means inside
+}
+
+static void polygon_edges_build(PolygonEdges *edges, const Polygon2 *polygon) {
+    size_t n = polygon->count;
+    if (edges->count != n || !edges->x) {
+        free(edges->x);
+        float *block = malloc(sizeof(*block) * (2 * (n + 1) + 7 * n));
+        assert(block && "polygon_edges_build: malloc failed");
+        edges->x = block;
+        edges->y = edges->x + n + 1;
+        edges->dx = edges->y + n + 1;
+        edges->dy = edges->dx + n;
+        edges->inv_len_sq = edges->dy + n;
+        edges->min_x = edges->inv_len_sq + n;
+        edges->min_y = edges->min_x + n;
+        edges->max_x = edges->min_y + n;
+        edges->max_y = edges->max_x + n;
+        edges->count = n;
+    }
+    for (size_t i = 0; i <= n; i++) {
+        edges->x[i] = polygon->items[i < n ? i : 0].x;
+        edges->y[i] = polygon->items[i < n ? i : 0].y;
+    }
+    for (size_t i = 0; i < n; i++) {
+        Vector2 d = sub_v2(polygon->items[i + 1 < n ? i + 1 : 0], polygon->items[i]);
+        edges->dx[i] = d.x;
+        edges->dy[i] = d.y;
+        float len_sq = len_v2_sq(d);
+        edges->inv_len_sq[i] = len_sq > 0 ? 1 / len_sq : 0;
+        edges->min_x[i] = fminf(edges->x[i], edges->x[i + 1]);
+        edges->min_y[i] = fminf(edges->y[i], edges->y[i + 1]);
+        edges->max_x[i] = fmaxf(edges->x[i], edges->x[i + 1]);
+        edges->max_y[i] = fmaxf(edges->y[i], edges->y[i + 1]);
+    }
+}
+
+static void polygon_edges_free(PolygonEdges *edges) {
+    free(edges->x);
+    *edges = (PolygonEdges){0};
+}
+
+static inline Vector2 edges_point(const PolygonEdges *edges, size_t i) {
+    return (Vector2){edges->x[i], edges->y[i]};
+}
+
+// Squared distance from the point to edge i, its start when the edge has no length
+static inline float edge_dist_sq(const PolygonEdges *edges, size_t i, Vector2 p) {
+    float px = p.x - edges->x[i], py = p.y - edges->y[i];
+    float t = (px * edges->dx[i] + py * edges->dy[i]) * edges->inv_len_sq[i];
+    t = t < 0 ? 0.0f : (t > 1 ? 1 : t);
+    float ex = px - t * edges->dx[i], ey = py - t * edges->dy[i];
+    return ex * ex + ey * ey;
+}
+
+// `point_inside` over the edges: winding number and distance to the closest edge in one pass
+static bool edges_point_inside(const PolygonEdges *edges, Vector2 point, float *min_dist) {
+    int winding_number = 0;
+    float best = __FLT_MAX__;
+    for (size_t i = 0; i < edges->count; i++) {
+        float dist = edge_dist_sq(edges, i, point);
+        if (best > dist) best = dist;
+
+        float cross = edges->dx[i] * (point.y - edges->y[i]) - edges->dy[i] * (point.x - edges->x[i]);
+        if (edges->y[i] <= point.y && edges->y[i + 1] > point.y) {
+            if (cross > 0) winding_number += 1;
+        } else if (edges->y[i] > point.y && edges->y[i + 1] <= point.y) {
+            if (cross < 0) winding_number -= 1;
+        }
+    }
+    *min_dist = edges->count > 0 ? sqrtf(best) : __FLT_MAX__;
+    return winding_number != 0;
+}
+
+// Distance from the point to the closest edge
+static float edges_distance(const PolygonEdges *edges, Vector2 point) {
+    float best = __FLT_MAX__;
+    for (size_t i = 0; i < edges->count; i++) {
+        float dist = edge_dist_sq(edges, i, point);
+        if (best > dist) best = dist;
+    }
+    return edges->count > 0 ? sqrtf(best) : __FLT_MAX__;
+}
+
+// `segment_intersect_polygon` over the edges of the closed polygon. Edges with boxes away from the box of the
+// segment, grown by MIN_POLYGON_DIST for the ones sharing an end with it, can't be hit and are skipped.
+static bool edges_cross_segment(const PolygonEdges *edges, Vector2 a, Vector2 b) {
+    if (same_v2(a, b)) return false;
+    float lo_x = fminf(a.x, b.x) - MIN_POLYGON_DIST, hi_x = fmaxf(a.x, b.x) + MIN_POLYGON_DIST;
+    float lo_y = fminf(a.y, b.y) - MIN_POLYGON_DIST, hi_y = fmaxf(a.y, b.y) + MIN_POLYGON_DIST;
+    for (size_t i = 0; i < edges->count; i++) {
+        if (edges->max_x[i] < lo_x || edges->min_x[i] > hi_x || edges->max_y[i] < lo_y || edges->min_y[i] > hi_y) continue;
+        Vector2 c = edges_point(edges, i);
+        Vector2 d = edges_point(edges, i + 1);
+        bool a_is_c = same_v2(a, c);
+        bool a_is_d = same_v2(a, d);
+        bool b_is_c = same_v2(b, c);
+        bool b_is_d = same_v2(b, d);
+
+        if ((a_is_c && b_is_d) || (a_is_d && b_is_c)) continue;
+        if (a_is_c || a_is_d) {
+            if (edge_dist_sq(edges, i, b) < MIN_POLYGON_DIST * MIN_POLYGON_DIST) return true;
+            continue;
+        }
+        if (b_is_c || b_is_d) {
+            if (edge_dist_sq(edges, i, a) < MIN_POLYGON_DIST * MIN_POLYGON_DIST) return true;
+            continue;
+        }
+        if (segments_intersect(a, b, c, d)) return true;
+    }
+    return false;
+}
+
+static Rectangle polygon_bounds(const Polygon2 *polygon) {
+    Vector2 lo = polygon->items[0], hi = polygon->items[0];
+    for (size_t i = 1; i < polygon->count; i++) {
+        lo.x = fminf(lo.x, polygon->items[i].x); lo.y = fminf(lo.y, polygon->items[i].y);
+        hi.x = fmaxf(hi.x, polygon->items[i].x); hi.y = fmaxf(hi.y, polygon->items[i].y);
+    }
+    return (Rectangle){lo.x, lo.y, hi.x - lo.x, hi.y - lo.y};
+}
+
+static void grid_init(NodeGrid *grid, const Polygon2 *outline, Vector2 origin, float scale, float cell_size) {
+    Rectangle bounds = polygon_bounds(outline);
+    *grid = (NodeGrid){0};
+    grid->origin = origin;
+    grid->scale = scale;
+    grid->cell_size = cell_size;
+    // Couple of spare cells around, anything beyond them is clamped to the border cells
+    grid->min = sub_v2((Vector2){bounds.x - origin.x, bounds.y - origin.y}, (Vector2){2 * cell_size, 2 * cell_size});
+    grid->cols = (int)(bounds.width / cell_size) + 5;
+    grid->rows = (int)(bounds.height / cell_size) + 5;
+    grid->cells = calloc((size_t)grid->cols * grid->rows, sizeof(Indeces));
+    assert(grid->cells && "grid_init: calloc failed");
+}
+
+static void grid_free(NodeGrid *grid) {
+    for (int i = 0; i < grid->cols * grid->rows; i++) {
+        free(grid->cells[i].items);
+    }
+    free(grid->cells);
+    *grid = (NodeGrid){0};
+}
+
+static inline int clamp_i(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+static inline int grid_col(const NodeGrid *grid, float world_x) {
+    float blade_x = (world_x - grid->origin.x) / grid->scale;
+    return clamp_i((int)floorf((blade_x - grid->min.x) / grid->cell_size), 0, grid->cols - 1);
+}
+
+static inline int grid_row(const NodeGrid *grid, float world_y) {
+    float blade_y = (world_y - grid->origin.y) / grid->scale;
+    return clamp_i((int)floorf((blade_y - grid->min.y) / grid->cell_size), 0, grid->rows - 1);
+}
+
+static void grid_insert(NodeGrid *grid, Vector2 point, size_t index) {
+    Indeces *cell = &grid->cells[grid_row(grid, point.y) * grid->cols + grid_col(grid, point.x)];
+    DA_APPEND(cell, index);
+}
+
+// Cells covering a world space circle, slightly inflated against rounding on the cell borders
+static void grid_range(const NodeGrid *grid, Vector2 center, float radius, int *x0, int *y0, int *x1, int *y1) {
+    radius += 1e-3f * grid->cell_size * grid->scale;
+    *x0 = grid_col(grid, center.x - radius);
+    *x1 = grid_col(grid, center.x + radius);
+    *y0 = grid_row(grid, center.y - radius);
+    *y1 = grid_row(grid, center.y + radius);
+}
+
+static bool tiling_init(Tiling *tiling, Rectangle bounds, float size, const char *spill_file) {
+    *tiling = (Tiling){0};
+    tiling->spill = fopen(spill_file, "w+b");
+    if (!tiling->spill) {
+        printf("Can't open file: %s\n", spill_file);
+        return false;
+    }
+    tiling->min = (Vector2){bounds.x, bounds.y};
+    tiling->size = size;
+    tiling->cols = (int)(bounds.width / size) + 1;
+    tiling->rows = (int)(bounds.height / size) + 1;
+    tiling->items = calloc((size_t)tiling->cols * tiling->rows, sizeof(Tile));
+    assert(tiling->items && "tiling_init: calloc failed");
+    for (size_t i = 0; i < (size_t)tiling->cols * tiling->rows; i++) {
+        DA_APPEND(&tiling->active, i);
+    }
+    return true;
+}
+
+static void tiling_free(Tiling *tiling) {
+    if (tiling->spill) fclose(tiling->spill);
+    free(tiling->items);
+    free(tiling->active.items);
+    *tiling = (Tiling){0};
+}
+
+static inline int tile_at(const Tiling *tiling, Vector2 p) {
+    int x = clamp_i((int)floorf((p.x - tiling->min.x) / tiling->size), 0, tiling->cols - 1);
+    int y = clamp_i((int)floorf((p.y - tiling->min.y) / tiling->size), 0, tiling->rows - 1);
+    return y * tiling->cols + x;
+}
+
+// Only true when growing out of core, everything is active otherwise
+static inline bool tile_finalised(const Tiling *tiling, Vector2 p) {
+    return tiling->spill && tiling->items[tile_at(tiling, p)].state == TILE_FINALISED;
+}
+
+static void *scratch_alloc(Scratch *scratch, size_t size) {
+    size = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t) * sizeof(max_align_t);
+    scratch->wanted += size;
+    if (scratch->used + size <= scratch->capacity) {
+        void *ptr = scratch->base + scratch->used;
+        scratch->used += size;
+        return ptr;
+    }
+    ScratchBlock *block = malloc(sizeof(*block) + size);
+    assert(block && "scratch_alloc: malloc failed");
+    scratch->heap_allocs++;
+    block->next = scratch->overflow;
+    scratch->overflow = block;
+    return block->data;
+}
+
+static void scratch_reset(Scratch *scratch) {
+    while (scratch->overflow) {
+        ScratchBlock *next = scratch->overflow->next;
+        free(scratch->overflow);
+        scratch->overflow = next;
+    }
+    if (scratch->wanted > scratch->capacity) {
+        free(scratch->base);
+        scratch->base = malloc(scratch->wanted);
+        assert(scratch->base && "scratch_reset: malloc failed");
+        scratch->capacity = scratch->wanted;
+        scratch->heap_allocs++;
+    }
+    scratch->used = 0;
+    scratch->wanted = 0;
+}
+
+static void scratch_free(Scratch *scratch) {
+    scratch_reset(scratch);
+    free(scratch->base);
+    *scratch = (Scratch){0};
+}
+
+static bool piece_contains(const Decomposition *decomposition, const PolygonEdges *edges, size_t piece, Vector2 p) {
+    const Indeces *points = &decomposition->pieces.items[piece].points;
+    for (size_t k = 0; k < points->count; k++) {
+        size_t a = points->items[k];
+        size_t b = points->items[k + 1 < points->count ? k + 1 : 0];
+        Vector2 pa = edges_point(edges, a);
+        float cross = decomposition->winding * cross_v2(sub_v2(edges_point(edges, b), pa), sub_v2(p, pa));
+        // Diagonals are shared, points on them belong to both sides
+        bool outline_edge = b == a + 1 || (b == 0 && a + 1 == edges->count);
+        if (outline_edge ? cross <= 0 : cross < 0) return false;
+    }
+    return true;
+}
+
+// Piece the point is inside of. Points on the outline are left out, the edge test has its own rules for them.
+static size_t locate_piece(const Decomposition *decomposition, const PolygonEdges *edges, Vector2 p) {
+    for (size_t i = 0; i < decomposition->pieces.count; i++) {
+        if (piece_contains(decomposition, edges, i, p)) return i;
+    }
+    return NO_PIECE;
+}
+
+// Line of sight between two points of the blade. Points in the same piece, or in neighbouring pieces with
+// the segment going through their diagonal, see each other. Only segments across concavities test all edges.
+static bool in_sight(const Decomposition *decomposition, const PolygonEdges *edges, Vector2 a, size_t piece_a, Vector2 b, size_t piece_b) {
+    if (piece_a != NO_PIECE && piece_b != NO_PIECE) {
+        if (piece_a == piece_b) return true;
+        const Indeces *diagonals = &decomposition->pieces.items[piece_a].diagonals;
+        for (size_t k = 0; k < diagonals->count; k++) {
+            const Diagonal *diagonal = &decomposition->diagonals.items[diagonals->items[k]];
+            if (diagonal->pieces[0] != piece_b && diagonal->pieces[1] != piece_b) continue;
+            if (segments_intersect(a, b, edges_point(edges, diagonal->a), edges_point(edges, diagonal->b))) return true;
+            break;
+        }
+    }
+    return !edges_cross_segment(edges, a, b);
+}
+
+// Cells with auxins dying on the outline left out: with half their diagonal under a quarter of the auxin radius
+// a cell whose center is closer to the outline than that is all within half the radius of it
+static void free_space_init(FreeSpace *space, Rectangle bounds, const PolygonEdges *edges, float auxin_radius) {
+    *space = (FreeSpace){0};
+    space->min = (Vector2){bounds.x, bounds.y};
+    space->cell_size = FREE_CELL_RATIO * auxin_radius;
+    space->cols = (int)(bounds.width / space->cell_size) + 1;
+    space->rows = (int)(bounds.height / space->cell_size) + 1;
+    size_t n = (size_t)space->cols * space->rows;
+    assert(n < FREE_NONE && "free_space_init: too many cells");
+    space->corners = calloc((size_t)(space->cols + 1) * (space->rows + 1), sizeof(*space->corners));
+    space->slots = malloc(sizeof(*space->slots) * n);
+    space->cells = malloc(sizeof(*space->cells) * n);
+    assert(space->corners && space->slots && space->cells && "free_space_init: allocation failed");
+
+    float half_diagonal = space->cell_size * (float)M_SQRT1_2;
+    for (int y = 0; y < space->rows; y++) {
+        for (int x = 0; x < space->cols; x++) {
+            uint32_t cell = (uint32_t)(y * space->cols + x);
+            Vector2 center = {space->min.x + (x + 0.5f) * space->cell_size, space->min.y + (y + 0.5f) * space->cell_size};
+            float dist;
+            if (edges_point_inside(edges, center, &dist) && dist > half_diagonal && dist + half_diagonal >= auxin_radius / 2) {
+                space->slots[cell] = (uint32_t)space->count;
+                space->cells[space->count++] = cell;
+            } else {
+                space->slots[cell] = FREE_NONE;
+            }
+        }
+    }
+}
+
+static void free_space_free(FreeSpace *space) {
+    free(space->corners);
+    free(space->slots);
+    free(space->cells);
+    *space = (FreeSpace){0};
+}
+
+static inline bool free_space_full(const FreeSpace *space) {
+    return space->slots && space->count == 0;
+}
+
+static inline bool free_space_open(const FreeSpace *space, Vector2 p) {
+    int x = (int)floorf((p.x - space->min.x) / space->cell_size);
+    int y = (int)floorf((p.y - space->min.y) / space->cell_size);
+    if (x < 0 || y < 0 || x >= space->cols || y >= space->rows) return false;
+    return space->slots[y * space->cols + x] != FREE_NONE;
+}
+
+// Last free cell takes the place of the dropped one
+static void free_space_drop(FreeSpace *space, int x, int y) {
+    if (x < 0 || y < 0 || x >= space->cols || y >= space->rows) return;
+    uint32_t cell = (uint32_t)(y * space->cols + x);
+    uint32_t slot = space->slots[cell];
+    if (slot == FREE_NONE) return;
+    const uint8_t *corners = space->corners + (size_t)y * (space->cols + 1) + x;
+    if (!corners[0] || !corners[1] || !corners[space->cols + 1] || !corners[space->cols + 2]) return;
+    uint32_t last = space->cells[--space->count];
+    space->cells[slot] = last;
+    space->slots[last] = slot;
+    space->slots[cell] = FREE_NONE;
+}
+
+// Covers the corners `node` sees within `radius` and drops the cells around them that got all four.
+// Free cells have no outline in them, so their corners are inside the blade.
+static void free_space_cover(FreeSpace *space, const Decomposition *decomposition, const PolygonEdges *edges, const Node *node,
+                             size_t piece, float radius) {
+    float size = space->cell_size;
+    int x0 = clamp_i((int)ceilf((node->center.x - radius - space->min.x) / size), 0, space->cols);
+    int x1 = clamp_i((int)floorf((node->center.x + radius - space->min.x) / size), 0, space->cols);
+    int y0 = clamp_i((int)ceilf((node->center.y - radius - space->min.y) / size), 0, space->rows);
+    int y1 = clamp_i((int)floorf((node->center.y + radius - space->min.y) / size), 0, space->rows);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            uint8_t *corner = &space->corners[(size_t)y * (space->cols + 1) + x];
+            if (*corner) continue;
+            Vector2 p = {space->min.x + x * size, space->min.y + y * size};
+            if (len_v2(sub_v2(p, node->center)) > radius) continue;
+            // Pieces are convex, only corners out of the node's piece need the edges
+            bool in_piece = piece != NO_PIECE && piece_contains(decomposition, edges, piece, p);
+            if (!in_piece && edges_cross_segment(edges, node->center, p)) continue;
+            *corner = 1;
+            free_space_drop(space, x - 1, y - 1);
+            free_space_drop(space, x, y - 1);
+            free_space_drop(space, x - 1, y);
+            free_space_drop(space, x, y);
+        }
+    }
+}
+
+static inline bool auxin_alive(const Auxins *auxins, size_t i) {
+    return (auxins->alive[i / 64] >> (i % 64)) & 1;
+}
+
+// Free slots are reused first and live auxins never outnumber the spray threshold, so with that many
+// slots reserved adding and removing auxins stays off the heap
+static void reserve_auxins(Auxins *auxins, size_t slots) {
+    if (slots <= auxins->capacity) return;
+    auxins->items = realloc(auxins->items, sizeof(*auxins->items) * slots);
+    auxins->capacity = slots;
+    size_t words = (slots + 63) / 64;
+    if (words > auxins->alive_words) {
+        auxins->alive = realloc(auxins->alive, sizeof(*auxins->alive) * words);
+        assert(auxins->alive && "reserve_auxins: realloc failed");
+        memset(auxins->alive + auxins->alive_words, 0, sizeof(*auxins->alive) * (words - auxins->alive_words));
+        auxins->alive_words = words;
+    }
+    auxins->free.items = realloc(auxins->free.items, sizeof(*auxins->free.items) * slots);
+    auxins->free.capacity = slots;
+    assert(auxins->items && auxins->free.items && "reserve_auxins: realloc failed");
+}
+
+static void add_auxin(Auxins *auxins, Source auxin) {
+    size_t i;
+    if (auxins->free.count > 0) {
+        i = auxins->free.items[--auxins->free.count];
+        auxins->items[i] = auxin;
+    } else {
+        i = auxins->count;
+        DA_APPEND(auxins, auxin);
+        if (auxins->count > auxins->alive_words * 64) {
+            size_t words = auxins->alive_words == 0 ? 4 : auxins->alive_words * 2;
+            auxins->alive = realloc(auxins->alive, sizeof(*auxins->alive) * words);
+            assert(auxins->alive && "add_auxin: realloc failed");
+            memset(auxins->alive + auxins->alive_words, 0, sizeof(*auxins->alive) * (words - auxins->alive_words));
+            auxins->alive_words = words;
+        }
+    }
+    auxins->alive[i / 64] |= (uint64_t)1 << (i % 64);
+    auxins->alive_count++;
+}
+
+static void remove_auxin(Auxins *auxins, size_t i) {
+    assert(auxin_alive(auxins, i) && "Removing auxin twice");
+    auxins->alive[i / 64] &= ~((uint64_t)1 << (i % 64));
+    auxins->alive_count--;
+    DA_APPEND((&auxins->free), i);
+}
+
+// Move alive auxins down to the front keeping their order, invalidates cached auxin indeces
+static void compact_auxins(Auxins *auxins) {
+    size_t count = 0;
+    for (size_t i = 0; i < auxins->count; i++) {
+        if (auxin_alive(auxins, i)) auxins->items[count++] = auxins->items[i];
+    }
+    memset(auxins->alive, 0, sizeof(*auxins->alive) * auxins->alive_words);
+    for (size_t i = 0; i < count; i++) auxins->alive[i / 64] |= (uint64_t)1 << (i % 64);
+    auxins->count = count;
+    auxins->free.count = 0;
+}
+
+static void free_auxins(Auxins *auxins) {
+    free(auxins->items);
+    free(auxins->alive);
+    free(auxins->free.items);
+    *auxins = (Auxins){0};
+}
+
+static void spray_chunk(const Spray *spray, SprayChunk *chunk) {
+    const Tiling *tiling = spray->tiling;
+    Rng *rng = &chunk->rng;
+    chunk->count = 0;
+    for (size_t k = 0; k < SPRAY_CHUNK; k++) {
+        Vector2 p;
+        if (tiling->spill) {
+            // Only into tiles that still grow, all of them are of the same size
+            size_t t = tiling->active.items[random_next(rng) % tiling->active.count];
+            p = (Vector2){
+                tiling->min.x + ((float)(t % tiling->cols) + random_float(rng)) * tiling->size,
+                tiling->min.y + ((float)(t / tiling->cols) + random_float(rng)) * tiling->size,
+            };
+        } else if (spray->density->count > 0) {
+            // Cell by the alias table, then anywhere in it
+            const Density *density = spray->density;
+            size_t cell = random_next(rng) % density->count;
+            if (random_float(rng) >= density->prob[cell]) cell = density->alias[cell];
+            Rectangle bounds = spray->bounds;
+            p = (Vector2){
+                bounds.x + ((float)(cell % density->cols) + random_float(rng)) * bounds.width / density->cols,
+                bounds.y + ((float)(cell / density->cols) + random_float(rng)) * bounds.height / density->rows,
+            };
+            // Covered cells are skipped before the costly tests
+            if (spray->free_space->slots && !free_space_open(spray->free_space, p)) continue;
+        } else if (spray->free_space->slots) {
+            // Only where auxins may still survive
+            const FreeSpace *space = spray->free_space;
+            uint32_t cell = space->cells[random_next(rng) % space->count];
+            p = (Vector2){
+                space->min.x + ((float)(cell % space->cols) + random_float(rng)) * space->cell_size,
+                space->min.y + ((float)(cell / space->cols) + random_float(rng)) * space->cell_size,
+            };
+        } else {
+            Rectangle bounds = spray->bounds;
+            p = (Vector2){bounds.x + random_float(rng) * bounds.width, bounds.y + random_float(rng) * bounds.height};
+        }
+        float min_dist;
+        if (edges_point_inside(spray->edges, p, &min_dist) && min_dist > AUXIN_DOT_RADIUS) {
+            assert(min_dist < __FLT_MAX__ && "A point inside the shape should have finite minimal distance");
+            chunk->found[chunk->count++] = (Source){
+                .center=p,
+                .radius=spray->params->auxin_radius,
+                .closest_node_index=0,
+                .piece=locate_piece(spray->decomposition, spray->edges, p),
+                .born=spray->step,
+            };
+        }
+    }
+}
+
+// Vose's alias method: cells get their weight scaled so that the average is 1, then every cell below 1
+// is topped up from one above it. False if every weight is 0.
+static bool density_build(Density *density, const uint8_t *values, int cols, int rows) {
+    size_t n = (size_t)cols * rows;
+    double total = 0;
+    for (size_t i = 0; i < n; i++) total += values[i];
+    if (n == 0 || total == 0) return false;
+
+    density->prob = realloc(density->prob, sizeof(*density->prob) * n);
+    density->alias = realloc(density->alias, sizeof(*density->alias) * n);
+    double *scaled = malloc(sizeof(*scaled) * n);
+    uint32_t *small = malloc(sizeof(*small) * n);
+    uint32_t *large = malloc(sizeof(*large) * n);
+    assert(density->prob && density->alias && scaled && small && large && "density_build: allocation failed");
+    size_t small_count = 0, large_count = 0;
+    for (size_t i = 0; i < n; i++) {
+        scaled[i] = values[i] * (double)n / total;
+        if (scaled[i] < 1) small[small_count++] = (uint32_t)i;
+        else large[large_count++] = (uint32_t)i;
+    }
+    while (small_count > 0 && large_count > 0) {
+        uint32_t s = small[--small_count], l = large[large_count - 1];
+        density->prob[s] = (float)scaled[s];
+        density->alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            large_count--;
+            small[small_count++] = l;
+        }
+    }
+    // Whatever is left is 1 up to rounding
+    while (large_count > 0) {
+        uint32_t l = large[--large_count];
+        density->prob[l] = 1;
+        density->alias[l] = l;
+    }
+    while (small_count > 0) {
+        uint32_t s = small[--small_count];
+        density->prob[s] = 1;
+        density->alias[s] = s;
+    }
+    density->count = n;
+    density->cols = cols;
+    density->rows = rows;
+    free(scaled);
+    free(small);
+    free(large);
+    return true;
+}
+
+static void density_free(Density *density) {
+    free(density->prob);
+    free(density->alias);
+    *density = (Density){0};
+}
+
+static void *spray_worker(void *arg) {
+    Spray *spray = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&spray->next, 1);
+        if (i >= spray->count) break;
+        spray_chunk(spray, &spray->chunks[i]);
+    }
+    return NULL;
+}
+
+static void *spray_helper(void *arg) {
+    SprayPool *pool = arg;
+    size_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->round == seen) pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->quit) break;
+        seen = pool->round;
+        Spray *spray = pool->spray;
+        pthread_mutex_unlock(&pool->lock);
+        spray_worker(spray);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void spray_pool_start(SprayPool *pool, size_t helpers) {
+    *pool = (SprayPool){0};
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if (helpers > SPRAY_HELPERS_MAX) helpers = SPRAY_HELPERS_MAX;
+    for (; pool->count < helpers; pool->count++) {
+        if (pthread_create(&pool->threads[pool->count], NULL, spray_helper, pool) != 0) break;
+    }
+}
+
+static void spray_pool_stop(SprayPool *pool) {
+    if (pool->count == 0) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->count; i++) pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    *pool = (SprayPool){0};
+}
+
+// Wakes the helpers for the round and draws along, returns once every chunk is drawn
+static void spray_pool_run(SprayPool *pool, Spray *spray) {
+    pthread_mutex_lock(&pool->lock);
+    pool->spray = spray;
+    pool->busy = pool->count;
+    pool->round++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    spray_worker(spray);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Candidates are drawn in chunks with a stream of their own, and taken in chunk order.
+// Which thread draws which chunk doesn't matter, so a seed gives the same leaf on any number of threads.
+static void spray_auxins(Auxins *auxins, const PolygonEdges *edges, const LeaferParams *params, Rng *rng, Rectangle bounds,
+                         const Density *density, const FreeSpace *free_space, const Tiling *tiling, const Decomposition *decomposition,
+                         size_t step, SprayPool *pool, size_t threads_count, Scratch *scratch) {
+    if (auxins->alive_count >= params->auxin_spray_threshold || free_space_full(free_space)) return;
+    Spray spray = {
+        .count=(params->auxin_spray_threshold - auxins->alive_count + SPRAY_CHUNK - 1) / SPRAY_CHUNK,
+        .edges=edges,
+        .params=params,
+        .bounds=bounds,
+        .tiling=tiling,
+        .decomposition=decomposition,
+        .density=density,
+        .free_space=free_space,
+        .step=step,
+    };
+    // Rounds only get smaller, the first one's chunks serve all of them
+    spray.chunks = scratch_alloc(scratch, sizeof(*spray.chunks) * spray.count);
+    // Half of what a full threshold takes is worth the helpers when that's under SPRAY_PARALLEL_MIN
+    size_t threshold_chunks = (params->auxin_spray_threshold + SPRAY_CHUNK - 1) / SPRAY_CHUNK;
+    size_t parallel_min = threshold_chunks / 2 < SPRAY_PARALLEL_MIN ? threshold_chunks / 2 : SPRAY_PARALLEL_MIN;
+    if (parallel_min < 2) parallel_min = 2;
+    while (auxins->alive_count < params->auxin_spray_threshold) {
+        spray.count = (params->auxin_spray_threshold - auxins->alive_count + SPRAY_CHUNK - 1) / SPRAY_CHUNK;
+        for (size_t i = 0; i < spray.count; i++) spray.chunks[i].rng = random_split(rng);
+        atomic_store(&spray.next, 0);
+
+        if (threads_count > 1 && spray.count >= parallel_min) {
+            if (pool->count == 0) spray_pool_start(pool, threads_count - 1);
+            spray_pool_run(pool, &spray); // this thread draws too
+        } else {
+            spray_worker(&spray);
+        }
+
+        size_t alive = auxins->alive_count;
+        for (size_t i = 0; i < spray.count; i++) {
+            const SprayChunk *chunk = &spray.chunks[i];
+            for (size_t k = 0; k < chunk->count && auxins->alive_count < params->auxin_spray_threshold; k++) {
+                add_auxin(auxins, chunk->found[k]);
+            }
+        }
+        // Free cells left may be hard to hit, e.g. dark on the density map, the next step tries again
+        if (auxins->alive_count == alive && free_space->slots) break;
+    }
+
+    // Free slots are reused first, so holes only pile up when fewer auxins are wanted than before
+    if (auxins->count >= AUXIN_COMPACT_MIN && auxins->free.count * 2 > auxins->count) compact_auxins(auxins);
+}
+
+// Auxin slots don't move within a step, so the work can be split into ranges of them: [begin, end)
+static void eliminate_auxins(Auxins *auxins, const Veins *veins, const size_t *node_pieces, const NodeGrid *grid, const PolygonEdges *edges,
+                             const Decomposition *decomposition, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        if (!auxin_alive(auxins, i)) continue;
+        const Source *auxin = &auxins->items[i];
+        float min_dist;
+        if (!edges_point_inside(edges, auxin->center, &min_dist) || min_dist < (auxin->radius / 2)) {
+            remove_auxin(auxins, i);
+            continue;
+        }
+        int x0, y0, x1, y1;
+        grid_range(grid, auxin->center, auxin->radius, &x0, &y0, &x1, &y1);
+        bool reached = false;
+        for (int y = y0; y <= y1 && !reached; y++) {
+            for (int x = x0; x <= x1 && !reached; x++) {
+                const Indeces *cell = &grid->cells[y * grid->cols + x];
+                for (size_t k = 0; k < cell->count; k++) {
+                    const Node *node = &veins->items[cell->items[k]];
+                    // Take into account that thier might not be a direct path, yet it probably does not matter much
+                    if (len_v2(sub_v2(auxin->center, node->center)) <= auxin->radius &&
+                        in_sight(decomposition, edges, auxin->center, auxin->piece, node->center, node_pieces[cell->items[k]])) {
+                        reached = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (reached) remove_auxin(auxins, i);
+    }
+}
+
+// Find closest node for each auxin in [begin, end)
+static void associate_auxins(Auxins *auxins, const Veins *veins, const size_t *node_pieces, const NodeGrid *grid, const PolygonEdges *edges,
+                             const Decomposition *decomposition, size_t begin, size_t end) {
+    float cell_world = grid->cell_size * grid->scale;
+    int max_ring = grid->cols > grid->rows ? grid->cols : grid->rows;
+    for (size_t i = begin; i < end; i++) {
+        if (!auxin_alive(auxins, i)) continue;
+        Vector2 center = auxins->items[i].center;
+        size_t piece = auxins->items[i].piece;
+        float min_dist = __FLT_MAX__;
+        size_t closest = veins->count;
+        int cx = grid_col(grid, center.x);
+        int cy = grid_row(grid, center.y);
+        // Walk square rings of cells around the auxin until nothing unvisited can be closer
+        for (int ring = 0; ring <= max_ring; ring++) {
+            for (int y = cy - ring; y <= cy + ring; y++) {
+                if (y < 0 || y >= grid->rows) continue;
+                bool edge_row = (y == cy - ring || y == cy + ring);
+                for (int x = cx - ring; x <= cx + ring; x += (edge_row || ring == 0) ? 1 : 2 * ring) {
+                    if (x < 0 || x >= grid->cols) continue;
+                    const Indeces *cell = &grid->cells[y * grid->cols + x];
+                    for (size_t k = 0; k < cell->count; k++) {
+                        size_t j = cell->items[k];
+                        float dist = len_v2(sub_v2(center, veins->items[j].center));
+                        // Ties go to the oldest node, as if nodes were visited in order
+                        if ((min_dist > dist || (min_dist == dist && j < closest)) &&
+                            // Thier might not be direct path
+                            in_sight(decomposition, edges, center, piece, veins->items[j].center, node_pieces[j])) {
+                            min_dist = dist;
+                            closest = j;
+                        }
+                    }
+                }
+            }
+            if (closest < veins->count && min_dist <= ring * cell_world) break;
+        }
+        auxins->items[i].closest_node_index = closest;
+
+        // Remove auxins that have no direct path to any vein node
+        if (auxins->items[i].closest_node_index >= veins->count) remove_auxin(auxins, i);
+    }
+}
+
+// Associate auxins with correcponding nodes: count them, hand out slices of one array, fill the slices
+static void link_auxins(const Auxins *auxins, Veins *veins, Scratch *scratch) {
+    for (size_t i = 0; i < veins->count; i++) {
+        veins->items[i].closest_source_indeces.count = 0;
+    }
+    for (size_t i = 0; i < auxins->count; i++) {
+        if (!auxin_alive(auxins, i)) continue;
+        size_t vein_idx = auxins->items[i].closest_node_index;
+        assert(vein_idx < veins->count && "Invalid auxin leaked into association");
+        veins->items[vein_idx].closest_source_indeces.count++;
+    }
+    size_t *sources = scratch_alloc(scratch, sizeof(*sources) * auxins->alive_count);
+    size_t offset = 0;
+    for (size_t i = 0; i < veins->count; i++) {
+        Indeces *closest = &veins->items[i].closest_source_indeces;
+        closest->items = sources + offset;
+        closest->capacity = closest->count;
+        offset += closest->count;
+        closest->count = 0;
+    }
+    for (size_t i = 0; i < auxins->count; i++) {
+        if (!auxin_alive(auxins, i)) continue;
+        Indeces *closest = &veins->items[auxins->items[i].closest_node_index].closest_source_indeces;
+        closest->items[closest->count++] = i;
+    }
+}
+
+static void produce_new_nodes(const Auxins *auxins, const PolygonEdges *edges, const LeaferParams *params, Veins *veins, Indeces *node_pieces, NodeGrid *grid, const Tiling *tiling, const Decomposition *decomposition, size_t gen, Scratch *scratch) {
+    float max_radius = fmaxf(params->vein_radius, params->vein_radius_min);
+
+    // Every pulled node has an auxin of its own, so live auxins bound both lists
+    size_t bound = auxins->alive_count;
+
+    // Indices of veins to be processed
+    Indeces to_process = {.items=scratch_alloc(scratch, sizeof(size_t) * bound), .capacity=bound};
+    for (size_t i = 0; i < veins->count; i++) {
+        const Node *node = &veins->items[i];
+        // Skip nodes with no connections
+        if (node->closest_source_indeces.count == 0) continue;
+        assert(to_process.count < to_process.capacity && "More pulled nodes than auxins");
+        to_process.items[to_process.count++] = i;
+    }
+
+    // Indices of veins that have sources pulling them (sorted in descending order of magnitude)
+    Indeces to_duplicate = {.items=scratch_alloc(scratch, sizeof(size_t) * bound), .capacity=bound};
+    while (to_process.count > 0) {
+        // Find maximum magnitude
+        size_t max_connections = 0;
+        for (size_t k = 0; k < to_process.count; k++) {
+            size_t i = to_process.items[k];
+            if (veins->items[i].closest_source_indeces.count > max_connections)
+                max_connections = veins->items[i].closest_source_indeces.count;
+        }
+        // Move nodes with maximum magnitude to array for further duplication
+        for (size_t k = 0; k < to_process.count;) {
+            size_t i = to_process.items[k];
+            if (veins->items[i].closest_source_indeces.count == max_connections) {
+                to_duplicate.items[to_duplicate.count++] = i;
+                // processed - delete
+                assert(to_process.count > 0 && "Attempting to remove from an empty array");
+                to_process.items[k] = to_process.items[to_process.count - 1];
+                to_process.count--;
+            } else {
+                k++;
+            }
+        }
+    }
+
+    // Duplicate nodes in descending order by their pulling force.
+    for (size_t k = 0; k < to_duplicate.count; k++) {
+        size_t i = to_duplicate.items[k];
+        const Node *parent = &veins->items[i];
+
+        // Calculate normalized sum
+        Vector2 normalized_sum = (Vector2){0};
+        for (size_t j = 0; j < parent->closest_source_indeces.count; j++) {
+            size_t auxin_idx = parent->closest_source_indeces.items[j];
+            normalized_sum = add_v2(normalized_sum, norm_v2(sub_v2(auxins->items[auxin_idx].center, parent->center)));
+        }
+        normalized_sum = norm_v2(normalized_sum); // Final normalization
+
+        float new_radius = parent->radius * (float)parent->gen / (float)gen;
+        if (new_radius < params->vein_radius_min) new_radius = params->vein_radius_min;
+
+        // Add new vein node
+        Vector2 new_center = add_v2(parent->center, scale_v2(normalized_sum, parent->radius + new_radius));
+        // Finalised tiles are already written out
+        if (tile_finalised(tiling, new_center)) continue;
+
+        // Check if new node fits in
+        // Becuase nodes are sorted, this process always favours those with more sources attached
+        // Against edges
+        if (edges_distance(edges, new_center) < (params->toleration_ratio * new_radius)) continue;
+        // Against other nodes
+        bool fits = true;
+        int x0, y0, x1, y1;
+        grid_range(grid, new_center, params->toleration_ratio * (new_radius + max_radius), &x0, &y0, &x1, &y1);
+        for (int y = y0; y <= y1 && fits; y++) {
+            for (int x = x0; x <= x1 && fits; x++) {
+                const Indeces *cell = &grid->cells[y * grid->cols + x];
+                for (size_t c = 0; c < cell->count; c++) {
+                    const Node *node = &veins->items[cell->items[c]];
+                    float cent_dist = len_v2(sub_v2(new_center, node->center));
+                    if (cent_dist < (params->toleration_ratio * ((float)new_radius + node->radius))) {
+                        fits = false;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!fits) continue;
+
+        // Appending may move the nodes, don't touch `parent` after this point
+        Node node = {
+            .center=new_center,
+            .radius=new_radius,
+            .closest_source_indeces=(Indeces){0},
+            .parent=parent->center,
+            .gen=gen,
+        };
+        DA_APPEND(veins, node);
+        DA_APPEND(node_pieces, locate_piece(decomposition, edges, new_center));
+        grid_insert(grid, new_center, veins->count - 1);
+    }
+}
+
+static inline void progress_set(LeaferProgress *progress, size_t done, size_t total) {
+    if (!progress) return;
+    atomic_store(&progress->total, total);
+    atomic_store(&progress->done, done);
+}
+
+// Takes the whole scratch memory, don't call it in the middle of a step. `progress` may be NULL.
+// False if a whole pass around the remaining points finds no ear, e.g. on an outline that touches itself.
+static bool construct_vertices(LeaferTriangles *vertices, const Polygon2 *polygon, Scratch *scratch, LeaferProgress *progress) {
+    scratch_reset(scratch);
+    size_t points_count = polygon->count;
+    progress_set(progress, 0, points_count - 3);
+    Vector2 *points = scratch_alloc(scratch, points_count * sizeof(Vector2));
+    memcpy(points, polygon->items, points_count * sizeof(Vector2));
+
+    size_t i = 0;
+    size_t misses = 0;
+    while (points_count > 3) {
+        if (misses == points_count) {
+            scratch_reset(scratch);
+            return false;
+        }
+        Vector2 curr = points[i];
+        Vector2 next = points[(i + 1) % points_count];
+        Vector2 prev = points[(i == 0 ? points_count - 1 : i - 1)];
+        // Ear Clipping: test if the edge from neighboring points inside the polygon
+        Vector2 test_edge = sub_v2(prev, next);
+        Vector2 test_point = {next.x + test_edge.x / 2, next.y + test_edge.y / 2};
+        float min_dist;
+        if (point_inside(test_point, polygon, &min_dist) && !segment_intersect_polygon(next, prev, polygon)) {
+            assert(min_dist < __FLT_MAX__ && "A point inside the shape should have finite minimal distance");
+            float cross = cross_v2(sub_v2(next, curr), sub_v2(prev, curr));
+            LeaferTriangle t = (cross < 0 ? (LeaferTriangle){curr, next, prev} : (LeaferTriangle){curr, prev, next});
+            DA_APPEND(vertices, t);
+
+            // Remove curr point without re-shuffle, sadge
+            for (size_t j = i; j < points_count - 1; j++) {
+                points[j] = points[j + 1];
+            }
+            points_count--;
+            misses = 0;
+            progress_set(progress, polygon->count - points_count, polygon->count - 3);
+        } else {
+            i++;
+            misses++;
+        }
+        // Rotate index around
+        i = i % points_count;
+    }
+    // And last triangle
+    Vector2 curr = points[0];
+    Vector2 next = points[1];
+    Vector2 prev = points[2];
+    float cross = cross_v2(sub_v2(next, curr), sub_v2(prev, curr));
+    LeaferTriangle t = (cross < 0 ? (LeaferTriangle){curr, next, prev} : (LeaferTriangle){curr, prev, next});
+    DA_APPEND(vertices, t);
+    scratch_reset(scratch);
+    return true;
+}
+
+static int compare_diagonals(const void *a, const void *b) {
+    const Diagonal *x = a, *y = b;
+    if (x->a != y->a) return x->a < y->a ? -1 : 1;
+    if (x->b != y->b) return x->b < y->b ? -1 : 1;
+    return 0;
+}
+
+static size_t find_piece(size_t *owner, size_t i) {
+    while (owner[i] != i) i = owner[i] = owner[owner[i]];
+    return i;
+}
+
+// Position of the x -> y edge in a closed cycle of indeces, count if it's not there
+static size_t cycle_edge(const Indeces *cycle, size_t x, size_t y) {
+    for (size_t k = 0; k < cycle->count; k++) {
+        if (cycle->items[k] == x && cycle->items[(k + 1) % cycle->count] == y) return k;
+    }
+    return cycle->count;
+}
+
+// Hertel-Mehlhorn: triangulate the outline, then drop every diagonal that leaves both of its ends convex
+// False if the outline can't be triangulated
+static bool decompose_polygon(Decomposition *decomposition, const Polygon2 *polygon, Scratch *scratch) {
+    size_t n = polygon->count;
+    float area = 0;
+    for (size_t i = 0; i < n; i++) area += cross_v2(polygon->items[i], polygon->items[(i + 1) % n]);
+    decomposition->winding = area < 0 ? -1 : 1;
+
+    // Triangles as cycles of outline indeces, each diagonal shows up twice - once from each side
+    LeaferTriangles triangles = (LeaferTriangles){0};
+    if (!construct_vertices(&triangles, polygon, scratch, NULL)) {
+        free(triangles.items);
+        return false;
+    }
+    Pieces cycles = (Pieces){0};
+    Diagonals sides = (Diagonals){0};
+    for (size_t t = 0; t < triangles.count; t++) {
+        const Vector2 corners[3] = {triangles.items[t].a, triangles.items[t].b, triangles.items[t].c};
+        size_t index[3];
+        for (size_t c = 0; c < 3; c++) {
+            index[c] = 0;
+            while (index[c] < n && !same_v2(polygon->items[index[c]], corners[c])) index[c]++;
+            assert(index[c] < n && "Triangle corner is not on the outline");
+        }
+        if (decomposition->winding * orient(polygon->items[index[0]], polygon->items[index[1]], polygon->items[index[2]]) < 0) {
+            size_t tmp = index[1]; index[1] = index[2]; index[2] = tmp;
+        }
+        Piece cycle = (Piece){0};
+        for (size_t c = 0; c < 3; c++) {
+            size_t a = index[c], b = index[(c + 1) % 3];
+            DA_APPEND(&cycle.points, a);
+            if ((a + 1) % n == b || (b + 1) % n == a) continue;
+            DA_APPEND(&sides, ((Diagonal){.a=a < b ? a : b, .b=a < b ? b : a, .pieces={t, NO_PIECE}}));
+        }
+        DA_APPEND(&cycles, cycle);
+    }
+    free(triangles.items);
+    qsort(sides.items, sides.count, sizeof(*sides.items), compare_diagonals);
+
+    size_t *owner = scratch_alloc(scratch, sizeof(size_t) * cycles.count);
+    for (size_t i = 0; i < cycles.count; i++) owner[i] = i;
+    Diagonals kept = (Diagonals){0};
+    for (size_t i = 0; i + 1 < sides.count; i++) {
+        if (compare_diagonals(&sides.items[i], &sides.items[i + 1]) != 0) continue;
+        Diagonal diagonal = sides.items[i];
+        diagonal.pieces[1] = sides.items[++i].pieces[0];
+
+        // Pieces came from a triangulation, so they share nothing but this diagonal: x -> y in one, y -> x in other
+        size_t p = find_piece(owner, diagonal.pieces[0]);
+        size_t q = find_piece(owner, diagonal.pieces[1]);
+        Indeces *P = &cycles.items[p].points;
+        Indeces *Q = &cycles.items[q].points;
+        size_t k = cycle_edge(P, diagonal.a, diagonal.b);
+        if (k == P->count) k = cycle_edge(P, diagonal.b, diagonal.a);
+        assert(k < P->count && "Diagonal is not on its piece");
+        size_t x = P->items[k], y = P->items[(k + 1) % P->count];
+        size_t m = cycle_edge(Q, y, x);
+        assert(m < Q->count && "Diagonal is not on its piece");
+
+        Vector2 x_prev = polygon->items[P->items[(k + P->count - 1) % P->count]];
+        Vector2 x_next = polygon->items[Q->items[(m + 2) % Q->count]];
+        Vector2 y_prev = polygon->items[Q->items[(m + Q->count - 1) % Q->count]];
+        Vector2 y_next = polygon->items[P->items[(k + 2) % P->count]];
+        if (decomposition->winding * orient(x_prev, polygon->items[x], x_next) < 0 ||
+            decomposition->winding * orient(y_prev, polygon->items[y], y_next) < 0) {
+            DA_APPEND(&kept, diagonal);
+            continue;
+        }
+
+        Indeces merged = (Indeces){0};
+        for (size_t j = 0; j < P->count; j++) DA_APPEND(&merged, P->items[(k + 1 + j) % P->count]);
+        for (size_t j = 0; j + 2 < Q->count; j++) DA_APPEND(&merged, Q->items[(m + 2 + j) % Q->count]);
+        free(P->items);
+        free(Q->items);
+        *P = merged;
+        *Q = (Indeces){0};
+        owner[q] = p;
+    }
+    free(sides.items);
+
+    // Surviving pieces get dense numbers, surviving diagonals connect them
+    size_t *number = scratch_alloc(scratch, sizeof(size_t) * cycles.count);
+    for (size_t i = 0; i < cycles.count; i++) {
+        if (find_piece(owner, i) != i) continue;
+        number[i] = decomposition->pieces.count;
+        DA_APPEND(&decomposition->pieces, cycles.items[i]);
+    }
+    for (size_t i = 0; i < kept.count; i++) {
+        Diagonal diagonal = kept.items[i];
+        for (size_t c = 0; c < 2; c++) {
+            diagonal.pieces[c] = number[find_piece(owner, diagonal.pieces[c])];
+            DA_APPEND(&decomposition->pieces.items[diagonal.pieces[c]].diagonals, decomposition->diagonals.count);
+        }
+        DA_APPEND(&decomposition->diagonals, diagonal);
+    }
+    free(kept.items);
+    free(cycles.items);
+    scratch_reset(scratch);
+    return true;
+}
+
+static void decomposition_free(Decomposition *decomposition) {
+    for (size_t i = 0; i < decomposition->pieces.count; i++) {
+        free(decomposition->pieces.items[i].points.items);
+        free(decomposition->pieces.items[i].diagonals.items);
+    }
+    free(decomposition->pieces.items);
+    free(decomposition->diagonals.items);
+    *decomposition = (Decomposition){0};
+}
+
+#define NO_PARENT SIZE_MAX
+
+static inline uint64_t position_hash(Vector2 p) {
+    uint32_t x, y;
+    memcpy(&x, &p.x, sizeof(x));
+    memcpy(&y, &p.y, sizeof(y));
+    uint64_t state = ((uint64_t)x << 32) | y;
+    return splitmix64(&state);
+}
+
+// Index of the parent of every node, NO_PARENT for the root. Parents are referenced by position and
+// spilled nodes come back in tile order, so positions are looked up in a hash table. False for veins read
+// from a file that don't make a tree.
+static bool link_parents(const Veins *veins, Indeces *parents) {
+    size_t size = 16;
+    while (size < 2 * veins->count) size *= 2;
+    size_t *slots = calloc(size, sizeof(*slots)); // node index + 1, 0 when empty
+    assert(slots && "link_parents: calloc failed");
+    for (size_t i = 0; i < veins->count; i++) {
+        size_t s = position_hash(veins->items[i].center) & (size - 1);
+        while (slots[s]) s = (s + 1) & (size - 1);
+        slots[s] = i + 1;
+    }
+
+    for (size_t i = 0; i < veins->count; i++) {
+        Vector2 parent = veins->items[i].parent;
+        size_t index = NO_PARENT;
+        if (!same_v2(parent, (Vector2){-1, -1})) {
+            // Probing meets the nodes in the order they were inserted, same center resolves to the first one
+            size_t s = position_hash(parent) & (size - 1);
+            while (slots[s] && !same_v2(veins->items[slots[s] - 1].center, parent)) s = (s + 1) & (size - 1);
+            if (!slots[s]) {
+                printf("Can't find parent of veins node %zu\n", i);
+                free(slots);
+                return false;
+            }
+            index = slots[s] - 1;
+        }
+        DA_APPEND(parents, index);
+    }
+    free(slots);
+
+    // Every walk towards the root has to get there, or to a node an earlier walk went through
+    size_t *walked = calloc(veins->count > 0 ? veins->count : 1, sizeof(*walked)); // first node of the walk + 1
+    assert(walked && "link_parents: calloc failed");
+    bool tree = true;
+    for (size_t i = 0; i < veins->count && tree; i++) {
+        size_t j = i;
+        while (j != NO_PARENT && !walked[j]) {
+            walked[j] = i + 1;
+            j = parents->items[j];
+        }
+        if (j != NO_PARENT && walked[j] == i + 1) tree = false;
+    }
+    free(walked);
+    if (!tree) printf("Veins nodes are their own ancestors\n");
+    return tree;
+}
+
+// Pipe model: a vein carries everything its tips collect, so with Murray's law its radius goes with the
+// cube root of the number of tips above it. One pass from the tips down, a node is handled once all of
+// its children are. The root vein gets the full thickness, the thinnest ones are clamped to the start one.
+static void pipe_thickness(const Indeces *parents, float *thickness, Indeces *leaves) {
+    size_t n = parents->count;
+    size_t *pending = calloc(n, sizeof(*pending)); // children not handled yet
+    size_t *tips = calloc(n, sizeof(*tips));
+    size_t *queue = malloc(sizeof(*queue) * n);
+    assert(pending && tips && queue && "pipe_thickness: allocation failed");
+
+    for (size_t i = 0; i < n; i++) {
+        if (parents->items[i] != NO_PARENT) pending[parents->items[i]]++;
+    }
+    size_t queued = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (pending[i] > 0) continue;
+        tips[i] = 1;
+        queue[queued++] = i;
+        DA_APPEND(leaves, i);
+    }
+    size_t max_tips = 1;
+    for (size_t k = 0; k < queued; k++) {
+        size_t i = queue[k];
+        if (tips[i] > max_tips) max_tips = tips[i];
+        size_t parent = parents->items[i];
+        if (parent == NO_PARENT) continue;
+        tips[parent] += tips[i];
+        if (--pending[parent] == 0) queue[queued++] = parent;
+    }
+    assert(queued == n && "Veins are not a tree");
+
+    for (size_t i = 0; i < n; i++) {
+        float ratio = (float)tips[i] / (float)max_tips;
+        thickness[i] = fmaxf(LEAF_VEIN_THCK_START, LEAF_VEIN_THCK_END * powf(ratio, 1 / LEAF_VEIN_MURRAY_EXP));
+    }
+
+    free(pending);
+    free(tips);
+    free(queue);
+}
+
+static inline Vector2 mid_v2(Vector2 a, Vector2 b) { return (Vector2){(a.x + b.x) / 2, (a.y + b.y) / 2}; }
+
+// Chord of a quadratic arc strays at most |P0 - 2 P1 + P2| / (4 n^2) from it over n even steps
+static size_t arc_samples(Vector2 p0, Vector2 p1, Vector2 p2) {
+    float bend = len_v2(add_v2(sub_v2(p0, scale_v2(p1, 2)), p2));
+    size_t n = (size_t)ceilf(sqrtf(bend / (4 * SMOOTH_TOLERANCE)));
+    return n > 0 ? n : 1;
+}
+
+static inline Vector2 quadratic_v2(Vector2 p0, Vector2 p1, Vector2 p2, float t) {
+    float u = 1 - t;
+    return (Vector2){
+        u * u * p0.x + 2 * u * t * p1.x + t * t * p2.x,
+        u * u * p0.y + 2 * u * t * p1.y + t * t * p2.y,
+    };
+}
+
+// Limit of Chaikin's corner cutting, the quadratic B-spline with the branch as control polygon, evaluated
+// directly: a line from the first point to the middle of the first segment, an arc around every inner point
+// from the middle of one segment to the middle of the next one, and a line to the last point.
+// Widths follow the same curve. Points are counted first, so the smooth branch is allocated once, the
+// counts of the arcs are kept since fast math may round a second evaluation differently.
+static void smooth_branch(const LeaferBranch *branch, LeaferBranch *smooth) {
+    size_t n = branch->count;
+    const Vector2 *p = branch->items;
+    const float *w = branch->widths;
+    if (n < 3) {
+        smooth->items = malloc(sizeof(*smooth->items) * n);
+        smooth->widths = malloc(sizeof(*smooth->widths) * n);
+        assert(smooth->items && smooth->widths && "smooth_branch: malloc failed");
+        memcpy(smooth->items, p, sizeof(*p) * n);
+        memcpy(smooth->widths, w, sizeof(*w) * n);
+        smooth->count = smooth->capacity = n;
+        return;
+    }
+    size_t *arcs = malloc(sizeof(*arcs) * n);
+    size_t count = 3; // both ends and the middle of the first segment
+    for (size_t i = 1; i + 1 < n; i++) {
+        arcs[i] = arc_samples(mid_v2(p[i - 1], p[i]), p[i], mid_v2(p[i], p[i + 1]));
+        count += arcs[i];
+    }
+    smooth->items = malloc(sizeof(*smooth->items) * count);
+    smooth->widths = malloc(sizeof(*smooth->widths) * count);
+    assert(arcs && smooth->items && smooth->widths && "smooth_branch: malloc failed");
+    smooth->capacity = count;
+    smooth->count = 0;
+
+#define EMIT(point, width) do { smooth->widths[smooth->count] = (width); smooth->items[smooth->count++] = (point); } while (0)
+    EMIT(p[0], w[0]);
+    EMIT(mid_v2(p[0], p[1]), (w[0] + w[1]) / 2);
+    for (size_t i = 1; i + 1 < n; i++) {
+        Vector2 a = mid_v2(p[i - 1], p[i]), b = mid_v2(p[i], p[i + 1]);
+        float wa = (w[i - 1] + w[i]) / 2, wb = (w[i] + w[i + 1]) / 2;
+        for (size_t k = 1; k <= arcs[i]; k++) {
+            float t = (float)k / arcs[i], u = 1 - t;
+            EMIT(quadratic_v2(a, p[i], b, t), u * u * wa + 2 * u * t * w[i] + t * t * wb);
+        }
+    }
+    EMIT(p[n - 1], w[n - 1]);
+#undef EMIT
+    assert(smooth->count == count && "Smooth branch miscounted");
+    free(arcs);
+}
+
+// Area of the triangle a point spans with its neighbours, how much of the shape is lost without it
+static inline float spanned_area(Vector2 a, Vector2 p, Vector2 b) {
+    return fabsf(cross_v2(sub_v2(b, a), sub_v2(p, a))) / 2;
+}
+
+typedef struct Simplify {
+    const Vector2 *points;
+    size_t *prev;
+    size_t *next;
+    float *area;
+    size_t *heap; // points by their area, smallest first
+    size_t *slot; // where a point is in the heap
+    size_t count;
+} Simplify;
+
+static inline bool heap_less(const Simplify *s, size_t i, size_t j) {
+    // Ties go to the earlier point so the result doesn't depend on the heap layout
+    size_t a = s->heap[i], b = s->heap[j];
+    return s->area[a] < s->area[b] || (s->area[a] == s->area[b] && a < b);
+}
+
+static inline void heap_swap(Simplify *s, size_t i, size_t j) {
+    size_t tmp = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = tmp;
+    s->slot[s->heap[i]] = i;
+    s->slot[s->heap[j]] = j;
+}
+
+static void heap_fix(Simplify *s, size_t i) {
+    while (i > 0 && heap_less(s, i, (i - 1) / 2)) {
+        heap_swap(s, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s->count && heap_less(s, l, m)) m = l;
+        if (r < s->count && heap_less(s, r, m)) m = r;
+        if (m == i) break;
+        heap_swap(s, i, m);
+        i = m;
+    }
+}
+
+static void heap_remove(Simplify *s, size_t point) {
+    size_t i = s->slot[point];
+    s->count--;
+    if (i == s->count) return;
+    heap_swap(s, i, s->count);
+    heap_fix(s, i);
+}
+
+// Visvalingam-Whyatt: points spanning the smallest triangle with their neighbours go first, until every
+// one left spans at least `min_area`. A point never ranks below the one removed before it, so removals
+// don't erode a shape bit by bit. O(n log n) with a heap over the points. The first point stays, so does
+// the last one of an open polyline; a closed one keeps at least a triangle. Widths, if any, follow the points.
+static void simplify_polyline(Vector2 *points, float *widths, size_t *count, bool closed, float min_area) {
+    size_t n = *count;
+    if (min_area <= 0 || n < (closed ? 4u : 3u)) return;
+
+    Simplify s = {.points=points, .count=0};
+    s.prev = malloc(sizeof(*s.prev) * n);
+    s.next = malloc(sizeof(*s.next) * n);
+    s.area = malloc(sizeof(*s.area) * n);
+    s.heap = malloc(sizeof(*s.heap) * n);
+    s.slot = malloc(sizeof(*s.slot) * n);
+    assert(s.prev && s.next && s.area && s.heap && s.slot && "simplify_polyline: malloc failed");
+
+    for (size_t i = 0; i < n; i++) {
+        s.prev[i] = i > 0 ? i - 1 : n - 1;
+        s.next[i] = i + 1 < n ? i + 1 : 0;
+    }
+    size_t last = closed ? n : n - 1;
+    for (size_t i = 1; i < last; i++) {
+        s.area[i] = spanned_area(points[s.prev[i]], points[i], points[s.next[i]]);
+        s.heap[s.count] = i;
+        s.slot[i] = s.count++;
+    }
+    for (size_t i = s.count / 2; i-- > 0;) heap_fix(&s, i);
+
+    size_t left = n;
+    while (s.count > 0 && left > (closed ? 3u : 2u)) {
+        size_t i = s.heap[0];
+        float removed = s.area[i];
+        if (removed >= min_area) break;
+        heap_remove(&s, i);
+        left--;
+
+        size_t p = s.prev[i], q = s.next[i];
+        s.next[p] = q;
+        s.prev[q] = p;
+        size_t neighbours[2] = {p, q};
+        for (size_t k = 0; k < 2; k++) {
+            size_t j = neighbours[k];
+            if (j == 0 || (!closed && j == n - 1)) continue;
+            float area = spanned_area(points[s.prev[j]], points[j], points[s.next[j]]);
+            s.area[j] = area > removed ? area : removed;
+            heap_fix(&s, s.slot[j]);
+        }
+    }
+
+    // Removed points are the ones out of the list, the kept ones are in their original order
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i = s.next[i]) {
+        points[kept] = points[i];
+        if (widths) widths[kept] = widths[i];
+        kept++;
+        if (s.next[i] <= i) break;
+    }
+    *count = kept;
+
+    free(s.prev);
+    free(s.next);
+    free(s.area);
+    free(s.heap);
+    free(s.slot);
+}
+
+// Traverse vein nodes and create tree structure, every point carries the pipe model thickness of its node.
+// Smoothed branches are simplified down to triangles of at least `simplify` area.
+static bool traverse_parents(const Veins *veins, Vector2 root, float simplify, LeaferTree *tree, LeaferTree *smoothTree, LeaferProgress *progress) {
+    Indeces parents = (Indeces){0};
+    Indeces leaves = (Indeces){0};
+    if (!link_parents(veins, &parents)) {
+        free(parents.items);
+        return false;
+    }
+    float *thickness = malloc(sizeof(*thickness) * veins->count);
+    assert(thickness && "traverse_parents: malloc failed");
+    pipe_thickness(&parents, thickness, &leaves);
+
+    for (size_t i = 0; i < leaves.count; i++) {
+        progress_set(progress, i, leaves.count);
+        // Traverse from leaf to root
+        LeaferBranch branch = (LeaferBranch){0};
+        for (size_t j = leaves.items[i]; j != NO_PARENT; j = parents.items[j]) {
+            DA_APPEND(&branch, veins->items[j].center);
+        }
+        // Finish branch with the root point
+        DA_APPEND((&branch), root);
+        branch.widths = malloc(sizeof(*branch.widths) * branch.count);
+        assert(branch.widths && "traverse_parents: malloc failed");
+        size_t k = 0;
+        for (size_t j = leaves.items[i]; j != NO_PARENT; j = parents.items[j]) branch.widths[k++] = thickness[j];
+        branch.widths[k] = branch.widths[k - 1];
+
+        // Add both un-smoothed and smoothed branch to the trees
+        LeaferBranch smooth = (LeaferBranch){0};
+        smooth_branch(&branch, &smooth);
+        simplify_polyline(smooth.items, smooth.widths, &smooth.count, false, simplify);
+        DA_APPEND(tree, branch);
+        DA_APPEND(smoothTree, smooth);
+    }
+
+    free(thickness);
+    free(parents.items);
+    free(leaves.items);
+    return true;
+}
+
+// Buffered output for the exporters: everything goes through one fixed buffer, nothing is
+// accumulated in memory no matter how big the document is
+typedef struct Writer {
+    FILE *file;
+    size_t count;
+    bool failed;
+    char buffer[1 << 16];
+} Writer;
+
+static bool writer_open(Writer *writer, const char *file_name) {
+    writer->file = fopen(file_name, "wb");
+    writer->count = 0;
+    writer->failed = false;
+    if (!writer->file) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    return true;
+}
+
+static void writer_flush(Writer *writer) {
+    if (writer->count > 0 && fwrite(writer->buffer, 1, writer->count, writer->file) != writer->count) writer->failed = true;
+    writer->count = 0;
+}
+
+static bool writer_close(Writer *writer, const char *file_name) {
+    writer_flush(writer);
+    if (fclose(writer->file) != 0) writer->failed = true;
+    writer->file = NULL;
+    if (writer->failed) printf("Can't write to file: %s\n", file_name);
+    return !writer->failed;
+}
+
+static void write_bytes(Writer *writer, const void *data, size_t size) {
+    // Empty chunks like IEND come with no data at all, memcpy may not be given NULL even for nothing
+    if (size == 0) return;
+    if (writer->count + size > sizeof(writer->buffer)) {
+        writer_flush(writer);
+        if (size > sizeof(writer->buffer)) {
+            if (fwrite(data, 1, size, writer->file) != size) writer->failed = true;
+            return;
+        }
+    }
+    memcpy(writer->buffer + writer->count, data, size);
+    writer->count += size;
+}
+
+static inline void write_str(Writer *writer, const char *str) {
+    write_bytes(writer, str, strlen(str));
+}
+
+static void write_uint(Writer *writer, uint64_t value) {
+    char digits[24];
+    int n = sizeof(digits);
+    do {
+        digits[--n] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    write_bytes(writer, digits + n, sizeof(digits) - n);
+}
+
+// Fixed point with up to two decimals: precise enough for screen units and way faster than printf
+static void write_float(Writer *writer, float value) {
+    long long v = llroundf(value * 100.0f);
+    if (v < 0) {
+        write_bytes(writer, "-", 1);
+        v = -v;
+    }
+    write_uint(writer, (uint64_t)(v / 100));
+    int frac = (int)(v % 100);
+    if (frac) {
+        char buf[3] = {'.', '0' + frac / 10, '0' + frac % 10};
+        write_bytes(writer, buf, frac % 10 ? 3 : 2);
+    }
+}
+
+static void write_color(Writer *writer, const char *color_attr, const char *opacity_attr, Color color) {
+    static const char hex[] = "0123456789abcdef";
+    char buf[7] = {'#', hex[color.r >> 4], hex[color.r & 15], hex[color.g >> 4], hex[color.g & 15], hex[color.b >> 4], hex[color.b & 15]};
+    write_str(writer, color_attr);
+    write_str(writer, "=\"");
+    write_bytes(writer, buf, sizeof(buf));
+    write_str(writer, "\" ");
+    write_str(writer, opacity_attr);
+    write_str(writer, "=\"");
+    write_float(writer, color.a / 255.0f);
+    write_str(writer, "\"");
+}
+
+static inline void write_point(Writer *writer, char command, Vector2 p) {
+    write_bytes(writer, &command, 1);
+    write_float(writer, p.x);
+    write_bytes(writer, ",", 1);
+    write_float(writer, p.y);
+}
+
+// Side of a branch ribbon at point `j`, half of the vein thickness away from the center line
+static Vector2 ribbon_offset(const LeaferBranch *branch, size_t j, Vector2 prev_offset) {
+    Vector2 tangent = sub_v2(branch->items[j + 1 < branch->count ? j + 1 : j], branch->items[j > 0 ? j - 1 : j]);
+    // Smoothing leaves duplicated points behind, keep the previous direction on them
+    if (len_v2_sq(tangent) == 0) return prev_offset;
+    Vector2 normal = norm_v2((Vector2){-tangent.y, tangent.x});
+    return scale_v2(normal, branch->widths[j] / 2);
+}
+
+// Outline with the fill, then every branch as a filled ribbon of varying thickness with a color gradient
+static bool write_svg_file(const Polygon2 *polygon, const LeaferTree *tree, const char *file_name) {
+    Writer *writer = malloc(sizeof(*writer));
+    if (!writer_open(writer, file_name)) {
+        free(writer);
+        return false;
+    }
+
+    Rectangle bounds = polygon_bounds(polygon);
+    float margin = 2 * LEAF_VEIN_THCK_END;
+    Vector2 lo = {bounds.x - margin, bounds.y - margin};
+    Vector2 hi = {bounds.x + bounds.width + margin, bounds.y + bounds.height + margin};
+
+    write_str(writer, "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"");
+    write_float(writer, lo.x); write_str(writer, " ");
+    write_float(writer, lo.y); write_str(writer, " ");
+    write_float(writer, hi.x - lo.x); write_str(writer, " ");
+    write_float(writer, hi.y - lo.y); write_str(writer, "\" width=\"");
+    write_float(writer, hi.x - lo.x); write_str(writer, "\" height=\"");
+    write_float(writer, hi.y - lo.y); write_str(writer, "\">\n");
+
+    // Outline, filled as a single path to avoid seams between triangles
+    write_str(writer, "<path d=\"");
+    for (size_t i = 0; i < polygon->count; i++) {
+        write_point(writer, i == 0 ? 'M' : 'L', polygon->items[i]);
+    }
+    write_str(writer, "Z\" ");
+    write_color(writer, "fill", "fill-opacity", LEAFER_COLOR_FILL);
+    write_str(writer, " ");
+    write_color(writer, "stroke", "stroke-opacity", LEAFER_COLOR_OUTLINE);
+    write_str(writer, " stroke-width=\"3\" stroke-linejoin=\"round\"/>\n");
+
+    for (size_t i = 0; i < tree->count; i++) {
+        const LeaferBranch *branch = &tree->items[i];
+        if (branch->count < 2) continue;
+
+        // Gradient goes from the tip of the branch to the root, between the shades of their thickness
+        write_str(writer, "<linearGradient id=\"v");
+        write_uint(writer, i);
+        write_str(writer, "\" gradientUnits=\"userSpaceOnUse\" x1=\"");
+        write_float(writer, branch->items[0].x); write_str(writer, "\" y1=\"");
+        write_float(writer, branch->items[0].y); write_str(writer, "\" x2=\"");
+        write_float(writer, branch->items[branch->count - 1].x); write_str(writer, "\" y2=\"");
+        write_float(writer, branch->items[branch->count - 1].y); write_str(writer, "\"><stop offset=\"0\" ");
+        write_color(writer, "stop-color", "stop-opacity", lerp_color(LEAFER_COLOR_VEIN1, LEAFER_COLOR_VEIN2, vein_shade(branch->widths[0])));
+        write_str(writer, "/><stop offset=\"1\" ");
+        write_color(writer, "stop-color", "stop-opacity", lerp_color(LEAFER_COLOR_VEIN1, LEAFER_COLOR_VEIN2, vein_shade(branch->widths[branch->count - 1])));
+        write_str(writer, "/></linearGradient>\n");
+
+        // Ribbon: one side forward, other side backward, repeated points are skipped
+        write_str(writer, "<path d=\"");
+        Vector2 offset = {0};
+        for (size_t j = 0; j < branch->count; j++) {
+            if (j > 0 && same_v2(branch->items[j], branch->items[j - 1])) continue;
+            offset = ribbon_offset(branch, j, offset);
+            write_point(writer, j == 0 ? 'M' : 'L', add_v2(branch->items[j], offset));
+        }
+        for (size_t j = branch->count; j-- > 0;) {
+            if (j + 1 < branch->count && same_v2(branch->items[j], branch->items[j + 1])) continue;
+            offset = ribbon_offset(branch, j, offset);
+            write_point(writer, 'L', sub_v2(branch->items[j], offset));
+        }
+        write_str(writer, "Z\" fill=\"url(#v");
+        write_uint(writer, i);
+        write_str(writer, ")\"/>\n");
+    }
+    write_str(writer, "</svg>\n");
+
+    bool ok = writer_close(writer, file_name);
+    free(writer);
+    if (ok) printf("SVG saved to file: %s\n", file_name);
+    return ok;
+}
+
+// Veins are lifted a bit above the blade so they don't z-fight with it
+#define MESH_VEIN_LIFT 0.1f
+
+// Screen is y-down, meshes are y-up
+static inline Vector3 mesh_position(Vector2 p, float z) { return (Vector3){p.x, -p.y, z}; }
+
+// Vein point of the mesh and the first of its pair of vertices. Outline vertices come first, so 0 is never
+// a vein vertex and marks an empty slot.
+typedef struct MeshPoint {
+    Vector2 point;
+    uint32_t vertex;
+} MeshPoint;
+
+// Fill triangles share the outline points, veins become ribbons with two vertices per vein point.
+// UV of the blade spans its bounding box, UV of a ribbon goes across (u) and from tip to root (v).
+static void build_leaf_mesh(LeafMesh *mesh, const Polygon2 *polygon, const LeaferTriangles *vertices, const LeaferTree *tree) {
+    Rectangle bounds = polygon_bounds(polygon);
+    Vector2 lo = {bounds.x, bounds.y};
+    Vector2 size = {bounds.width, bounds.height};
+
+    for (size_t i = 0; i < polygon->count; i++) {
+        Vector2 p = polygon->items[i];
+        Vector2 uv = {(p.x - lo.x) / size.x, (p.y - lo.y) / size.y};
+        DA_APPEND(&mesh->vertices, ((MeshVertex){mesh_position(p, 0), uv, LEAFER_COLOR_FILL}));
+    }
+    for (size_t i = 0; i < vertices->count; i++) {
+        const Vector2 corners[3] = {vertices->items[i].a, vertices->items[i].b, vertices->items[i].c};
+        for (size_t c = 0; c < 3; c++) {
+            // Triangles are cut out of the outline, so each corner is one of its points
+            size_t index = 0;
+            while (index < polygon->count && !same_v2(polygon->items[index], corners[c])) index++;
+            assert(index < polygon->count && "Triangle corner is not on the outline");
+            DA_APPEND(&mesh->indices, (uint32_t)index);
+        }
+    }
+
+    // Branches run from their tips down to the root, so the veins near it are in many of them. Points are
+    // shared by position: each one gets a single pair of vertices and each segment a single quad.
+    size_t points = 0;
+    for (size_t i = 0; i < tree->count; i++) points += tree->items[i].count;
+    size_t slots = 16;
+    while (slots < 2 * points) slots *= 2;
+    MeshPoint *pairs = calloc(slots, sizeof(*pairs));
+    uint64_t *quads = calloc(slots, sizeof(*quads)); // first vertices of both pairs, 0 when empty
+    assert(pairs && quads && "build_leaf_mesh: calloc failed");
+
+    for (size_t i = 0; i < tree->count; i++) {
+        const LeaferBranch *branch = &tree->items[i];
+        Vector2 offset = {0};
+        uint32_t prev = 0;
+        for (size_t j = 0; j < branch->count; j++) {
+            offset = ribbon_offset(branch, j, offset);
+            Vector2 p = branch->items[j];
+            size_t s = position_hash(p) & (slots - 1);
+            while (pairs[s].vertex && !same_v2(pairs[s].point, p)) s = (s + 1) & (slots - 1);
+            if (!pairs[s].vertex) {
+                float v = branch->count > 1 ? (float)j / (float)(branch->count - 1) : 0;
+                Color color = lerp_color(LEAFER_COLOR_VEIN1, LEAFER_COLOR_VEIN2, vein_shade(branch->widths[j]));
+                pairs[s] = (MeshPoint){p, (uint32_t)mesh->vertices.count};
+                DA_APPEND(&mesh->vertices, ((MeshVertex){mesh_position(add_v2(p, offset), MESH_VEIN_LIFT), (Vector2){0, v}, color}));
+                DA_APPEND(&mesh->vertices, ((MeshVertex){mesh_position(sub_v2(p, offset), MESH_VEIN_LIFT), (Vector2){1, v}, color}));
+            }
+            uint32_t curr = pairs[s].vertex;
+            if (prev && prev != curr) {
+                uint64_t key = ((uint64_t)prev << 32) | curr;
+                uint64_t state = key;
+                size_t q = splitmix64(&state) & (slots - 1);
+                while (quads[q] && quads[q] != key) q = (q + 1) & (slots - 1);
+                if (!quads[q]) {
+                    quads[q] = key;
+                    uint32_t a = prev, b = prev + 1, c = curr, d = curr + 1;
+                    DA_APPEND(&mesh->indices, a); DA_APPEND(&mesh->indices, b); DA_APPEND(&mesh->indices, c);
+                    DA_APPEND(&mesh->indices, c); DA_APPEND(&mesh->indices, b); DA_APPEND(&mesh->indices, d);
+                }
+            }
+            prev = curr;
+        }
+    }
+    free(pairs);
+    free(quads);
+}
+
+static void free_leaf_mesh(LeafMesh *mesh) {
+    free(mesh->vertices.items);
+    free(mesh->indices.items);
+    *mesh = (LeafMesh){0};
+}
+
+// Compact veins archive. Nodes go parents first in depth-first order, so the first child of a node
+// directly follows it. Every node is stored as varints: offset back to its parent (0 for a root), then
+// position, radius and generation as zigzag deltas from the parent. Positions and radii are rounded to
+// multiples of the quantum, which the header keeps, each on its own so errors don't add up along a vein.
+#define COMPACT_VEINS_MAGIC "LVQ1"
+#define COMPACT_VEINS_QUANTUM (1.0f / 64) // power of two, so quantised values come back exactly
+
+static inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+static inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+
+static void put_varint(Bytes *out, uint64_t value) {
+    while (value >= 0x80) {
+        DA_APPEND(out, (uint8_t)value | 0x80);
+        value >>= 7;
+    }
+    DA_APPEND(out, (uint8_t)value);
+}
+
+// false if the data ends in the middle of the value
+static inline bool read_varint(const uint8_t **p, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        uint8_t byte = *(*p)++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct Quantised {
+    int64_t x;
+    int64_t y;
+    int64_t radius;
+} Quantised;
+
+static inline Quantised quantise_node(const Node *node, float quantum) {
+    return (Quantised){llroundf(node->center.x / quantum), llroundf(node->center.y / quantum), llroundf(node->radius / quantum)};
+}
+
+// Appends the encoded veins to `out`, false if they don't make a tree
+static bool encode_compact_veins(const Veins *veins, Bytes *out) {
+    size_t n = veins->count;
+    Indeces parents = (Indeces){0};
+    if (!link_parents(veins, &parents)) {
+        free(parents.items);
+        return false;
+    }
+
+    // Children of every node in one array, `first[i]..first[i + 1]`
+    size_t *first = calloc(n + 1, sizeof(*first));
+    size_t *children = malloc(sizeof(*children) * (n > 0 ? n : 1));
+    size_t *order = malloc(sizeof(*order) * (n > 0 ? n : 1)); // place of every node in the output
+    size_t *stack = malloc(sizeof(*stack) * (n > 0 ? n : 1));
+    assert(first && children && order && stack && "encode_compact_veins: allocation failed");
+    for (size_t i = 0; i < n; i++) {
+        if (parents.items[i] != NO_PARENT) first[parents.items[i] + 1]++;
+    }
+    for (size_t i = 0; i < n; i++) first[i + 1] += first[i];
+    for (size_t i = 0; i < n; i++) {
+        size_t parent = parents.items[i];
+        if (parent != NO_PARENT) children[first[parent]++] = i;
+    }
+    for (size_t i = n; i > 0; i--) first[i] = first[i - 1];
+    first[0] = 0;
+
+    float quantum = COMPACT_VEINS_QUANTUM;
+    uint8_t header[4 + sizeof(quantum)];
+    memcpy(header, COMPACT_VEINS_MAGIC, 4);
+    memcpy(header + 4, &quantum, sizeof(quantum));
+    for (size_t i = 0; i < sizeof(header); i++) DA_APPEND(out, header[i]);
+    put_varint(out, n);
+
+    size_t written = 0;
+    for (size_t root = 0; root < n; root++) {
+        if (parents.items[root] != NO_PARENT) continue;
+        size_t top = 0;
+        stack[top++] = root;
+        while (top > 0) {
+            size_t i = stack[--top];
+            size_t parent = parents.items[i];
+            Quantised q = quantise_node(&veins->items[i], quantum);
+            Quantised base = (Quantised){0};
+            size_t base_gen = 0;
+            if (parent != NO_PARENT) {
+                base = quantise_node(&veins->items[parent], quantum);
+                base_gen = veins->items[parent].gen;
+            }
+            order[i] = written;
+            put_varint(out, parent != NO_PARENT ? written - order[parent] : 0);
+            put_varint(out, zigzag(q.x - base.x));
+            put_varint(out, zigzag(q.y - base.y));
+            put_varint(out, zigzag(q.radius - base.radius));
+            put_varint(out, zigzag((int64_t)veins->items[i].gen - (int64_t)base_gen));
+            written++;
+            // Reversed, so the first child comes out next
+            for (size_t c = first[i + 1]; c > first[i]; c--) stack[top++] = children[c - 1];
+        }
+    }
+    assert(written == n && "Veins are not a tree");
+
+    free(first);
+    free(children);
+    free(order);
+    free(stack);
+    free(parents.items);
+    return true;
+}
+
+// Decodes straight into `veins`, false if the data is not whole
+static bool decode_compact_veins(Veins *veins, const uint8_t *data, size_t size) {
+    const uint8_t *p = data, *end = data + size;
+    float quantum = 0;
+    uint64_t count = 0;
+    if (size < 4 + sizeof(quantum) || memcmp(p, COMPACT_VEINS_MAGIC, 4) != 0) return false;
+    memcpy(&quantum, p + 4, sizeof(quantum));
+    p += 4 + sizeof(quantum);
+    // Every node takes at least five bytes
+    if (!(quantum > 0) || !read_varint(&p, end, &count) || count > (uint64_t)(end - p) / 5) return false;
+
+    veins->count = 0;
+    veins->capacity = count;
+    veins->items = realloc(veins->items, sizeof(Node) * (count > 0 ? count : 1));
+    Quantised *quantised = malloc(sizeof(*quantised) * (count > 0 ? count : 1));
+    assert(veins->items && quantised && "decode_compact_veins: allocation failed");
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; i++) {
+        uint64_t offset, x, y, radius, gen;
+        ok = read_varint(&p, end, &offset) && read_varint(&p, end, &x) && read_varint(&p, end, &y) &&
+             read_varint(&p, end, &radius) && read_varint(&p, end, &gen) && offset <= i;
+        if (!ok) break;
+        Quantised base = (Quantised){0};
+        int64_t base_gen = 0;
+        Vector2 parent = (Vector2){-1, -1};
+        if (offset > 0) {
+            base = quantised[i - offset];
+            base_gen = (int64_t)veins->items[i - offset].gen;
+            parent = veins->items[i - offset].center;
+        }
+        Quantised q = {base.x + unzigzag(x), base.y + unzigzag(y), base.radius + unzigzag(radius)};
+        quantised[i] = q;
+        veins->items[veins->count++] = (Node){
+            .center=(Vector2){q.x * quantum, q.y * quantum},
+            .radius=q.radius * quantum,
+            .parent=parent,
+            .gen=(size_t)(base_gen + unzigzag(gen)),
+        };
+    }
+    free(quantised);
+    return ok;
+}
+
+static bool write_compact_veins(const Veins *veins, const char *file_name) {
+    Bytes data = (Bytes){0};
+    if (!encode_compact_veins(veins, &data)) {
+        printf("Can't encode veins for file: %s\n", file_name);
+        free(data.items);
+        return false;
+    }
+    Writer *writer = malloc(sizeof(*writer));
+    assert(writer && "write_compact_veins: malloc failed");
+    bool ok = writer_open(writer, file_name);
+    if (ok) {
+        write_bytes(writer, data.items, data.count);
+        ok = writer_close(writer, file_name);
+    }
+    free(writer);
+    free(data.items);
+    if (ok) printf("Compact veins saved to file: %s\n", file_name);
+    return ok;
+}
+
+// The whole file is read at once and decoded in place
+static bool read_compact_veins(Veins *veins, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "rb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    long size = fseek(file_desc, 0, SEEK_END) == 0 ? ftell(file_desc) : -1;
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    assert(data && "read_compact_veins: malloc failed");
+    bool ok = size >= 0 && fseek(file_desc, 0, SEEK_SET) == 0 && fread(data, 1, size, file_desc) == (size_t)size;
+    if (fclose(file_desc) != 0) ok = false;
+    ok = ok && decode_compact_veins(veins, data, size);
+    free(data);
+    if (!ok) {
+        printf("Can't read compact veins from file: %s\n", file_name);
+        return false;
+    }
+    printf("Compact veins read from file: %s\n", file_name);
+    return true;
+}
+
+static inline void write_u32(Writer *writer, uint32_t value) {
+    // glTF is little endian, same as every platform this runs on
+    write_bytes(writer, &value, sizeof(value));
+}
+
+// Binary glTF: one interleaved vertex buffer (position, uv, color), one index buffer, one primitive
+static bool write_glb_file(const LeafMesh *mesh, const char *file_name) {
+    size_t vertices_size = mesh->vertices.count * sizeof(MeshVertex);
+    size_t indices_size = mesh->indices.count * sizeof(uint32_t);
+    size_t bin_size = vertices_size + indices_size; // both are multiples of 4 already
+
+    Vector3 lo = {__FLT_MAX__, __FLT_MAX__, __FLT_MAX__}, hi = {-__FLT_MAX__, -__FLT_MAX__, -__FLT_MAX__};
+    for (size_t i = 0; i < mesh->vertices.count; i++) {
+        Vector3 p = mesh->vertices.items[i].position;
+        lo.x = fminf(lo.x, p.x); lo.y = fminf(lo.y, p.y); lo.z = fminf(lo.z, p.z);
+        hi.x = fmaxf(hi.x, p.x); hi.y = fmaxf(hi.y, p.y); hi.z = fmaxf(hi.z, p.z);
+    }
+
+    char json[4096];
+    int json_len = snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Leafer\"},"
+        "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0,\"name\":\"Leaf\"}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1,\"COLOR_0\":2},\"indices\":3,\"material\":0}]}],"
+        "\"materials\":[{\"pbrMetallicRoughness\":{\"metallicFactor\":0,\"roughnessFactor\":1},\"alphaMode\":\"BLEND\",\"doubleSided\":true}],"
+        "\"buffers\":[{\"byteLength\":%zu}],"
+        "\"bufferViews\":["
+            "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"byteStride\":%zu,\"target\":34962},"
+            "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963}],"
+        "\"accessors\":["
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC2\"},"
+            "{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":5121,\"normalized\":true,\"count\":%zu,\"type\":\"VEC4\"},"
+            "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+        bin_size,
+        vertices_size, sizeof(MeshVertex),
+        vertices_size, indices_size,
+        offsetof(MeshVertex, position), mesh->vertices.count, lo.x, lo.y, lo.z, hi.x, hi.y, hi.z,
+        offsetof(MeshVertex, uv), mesh->vertices.count,
+        offsetof(MeshVertex, color), mesh->vertices.count,
+        mesh->indices.count);
+    assert(json_len > 0 && (size_t)json_len < sizeof(json) && "glTF header does not fit");
+    // Chunks are 4 byte aligned, JSON is padded with spaces
+    while (json_len % 4 != 0) json[json_len++] = ' ';
+
+    Writer *writer = malloc(sizeof(*writer));
+    assert(writer && "write_glb_file: malloc failed");
+    if (!writer_open(writer, file_name)) {
+        free(writer);
+        return false;
+    }
+    write_u32(writer, 0x46546C67); // "glTF"
+    write_u32(writer, 2);
+    write_u32(writer, (uint32_t)(12 + 8 + json_len + 8 + bin_size));
+    write_u32(writer, (uint32_t)json_len);
+    write_u32(writer, 0x4E4F534A); // "JSON"
+    write_bytes(writer, json, json_len);
+    write_u32(writer, (uint32_t)bin_size);
+    write_u32(writer, 0x004E4942); // "BIN"
+    write_bytes(writer, mesh->vertices.items, vertices_size);
+    write_bytes(writer, mesh->indices.items, indices_size);
+
+    bool ok = writer_close(writer, file_name);
+    free(writer);
+    if (ok) printf("glTF saved to file: %s\n", file_name);
+    return ok;
+}
+
+// Deflate bit stream, bits go least significant first
+typedef struct BitWriter {
+    Bytes *out;
+    uint32_t bits;
+    int count;
+} BitWriter;
+
+static void put_bits(BitWriter *bw, uint32_t value, int count) {
+    bw->bits |= value << bw->count;
+    bw->count += count;
+    while (bw->count >= 8) {
+        DA_APPEND(bw->out, (uint8_t)bw->bits);
+        bw->bits >>= 8;
+        bw->count -= 8;
+    }
+}
+
+// Huffman codes are the only thing stored most significant bit first
+static void put_code(BitWriter *bw, uint32_t code, int len) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < len; i++) reversed |= ((code >> i) & 1) << (len - 1 - i);
+    put_bits(bw, reversed, len);
+}
+
+// Literal/length alphabet of the fixed Huffman table
+static void put_literal(BitWriter *bw, int value) {
+    if      (value < 144) put_code(bw, 0x30 + value, 8);
+    else if (value < 256) put_code(bw, 0x190 + value - 144, 9);
+    else if (value < 280) put_code(bw, value - 256, 7);
+    else                  put_code(bw, 0xC0 + value - 280, 8);
+}
+
+static void put_match(BitWriter *bw, int length, int dist) {
+    static const uint16_t length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint8_t length_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+    static const uint16_t dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    static const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+    int l = 28;
+    while (length_base[l] > length) l--;
+    put_literal(bw, 257 + l);
+    put_bits(bw, length - length_base[l], length_extra[l]);
+    int d = 29;
+    while (dist_base[d] > dist) d--;
+    put_code(bw, d, 5);
+    put_bits(bw, dist - dist_base[d], dist_extra[d]);
+}
+
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_WINDOW    32768
+#define DEFLATE_MAX_MATCH 258
+
+static inline uint32_t hash3(const uint8_t *p) {
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Single block with the fixed Huffman table and greedy matching against the last occurrence
+// of every 3 byte sequence: flat leaf images shrink a lot, no dynamic tables needed
+static void deflate_fixed(Bytes *out, const uint8_t *data, size_t size) {
+    int64_t *head = malloc(sizeof(*head) << DEFLATE_HASH_BITS);
+    assert(head && "deflate_fixed: malloc failed");
+    for (size_t i = 0; i < (1u << DEFLATE_HASH_BITS); i++) head[i] = -1;
+
+    BitWriter bw = {.out=out};
+    put_bits(&bw, 1, 1); // final block
+    put_bits(&bw, 1, 2); // fixed Huffman codes
+    size_t i = 0;
+    while (i < size) {
+        size_t best = 0;
+        size_t dist = 0;
+        if (i + 3 <= size) {
+            uint32_t h = hash3(data + i);
+            int64_t candidate = head[h];
+            head[h] = (int64_t)i;
+            if (candidate >= 0 && i - (size_t)candidate <= DEFLATE_WINDOW) {
+                size_t max_len = size - i < DEFLATE_MAX_MATCH ? size - i : DEFLATE_MAX_MATCH;
+                while (best < max_len && data[candidate + best] == data[i + best]) best++;
+                dist = i - (size_t)candidate;
+            }
+        }
+        if (best >= 3) {
+            put_match(&bw, (int)best, (int)dist);
+            for (size_t k = 1; k < best && i + k + 3 <= size; k++) head[hash3(data + i + k)] = (int64_t)(i + k);
+            i += best;
+        } else {
+            put_literal(&bw, data[i]);
+            i++;
+        }
+    }
+    put_literal(&bw, 256); // end of block
+    if (bw.count > 0) put_bits(&bw, 0, 8 - bw.count);
+    free(head);
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 15];
+        crc = (crc >> 4) ^ table[crc & 15];
+    }
+    return ~crc;
+}
+
+static inline void write_u32_be(Writer *writer, uint32_t value) {
+    uint8_t buf[4] = {value >> 24, value >> 16, value >> 8, value};
+    write_bytes(writer, buf, sizeof(buf));
+}
+
+static void write_png_chunk(Writer *writer, const char type[4], const uint8_t *data, size_t size) {
+    write_u32_be(writer, (uint32_t)size);
+    write_bytes(writer, type, 4);
+    write_bytes(writer, data, size);
+    write_u32_be(writer, crc32_update(crc32_update(0, (const uint8_t *)type, 4), data, size));
+}
+
+// 8 bit RGBA image, every row uses the Sub filter which turns flat areas into zero runs
+static bool write_png_file(const Color *pixels, int width, int height, const char *file_name) {
+    size_t stride = 1 + 4 * (size_t)width;
+    uint8_t *filtered = malloc(stride * height);
+    assert(filtered && "write_png_file: malloc failed");
+    for (int y = 0; y < height; y++) {
+        uint8_t *row = filtered + y * stride;
+        const uint8_t *src = (const uint8_t *)(pixels + (size_t)y * width);
+        row[0] = 1;
+        for (size_t x = 0; x < 4 * (size_t)width; x++) row[1 + x] = src[x] - (x >= 4 ? src[x - 4] : 0);
+    }
+
+    // zlib stream: header, deflate data, adler32 of the uncompressed data
+    Bytes idat = (Bytes){0};
+    DA_APPEND(&idat, 0x78);
+    DA_APPEND(&idat, 0x01);
+    deflate_fixed(&idat, filtered, stride * height);
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < stride * height; i++) {
+        a = (a + filtered[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    uint32_t adler = (b << 16) | a;
+    for (int shift = 24; shift >= 0; shift -= 8) DA_APPEND(&idat, (uint8_t)(adler >> shift));
+    free(filtered);
+
+    Writer *writer = malloc(sizeof(*writer));
+    assert(writer && "write_png_file: malloc failed");
+    if (!writer_open(writer, file_name)) {
+        free(writer);
+        free(idat.items);
+        return false;
+    }
+    write_bytes(writer, "\x89PNG\r\n\x1a\n", 8);
+    uint8_t ihdr[13] = {
+        width >> 24, width >> 16, width >> 8, width,
+        height >> 24, height >> 16, height >> 8, height,
+        8, 6, 0, 0, 0, // 8 bit depth, RGBA, deflate, adaptive filtering, no interlace
+    };
+    write_png_chunk(writer, "IHDR", ihdr, sizeof(ihdr));
+    write_png_chunk(writer, "IDAT", idat.items, idat.count);
+    write_png_chunk(writer, "IEND", NULL, 0);
+    free(idat.items);
+
+    bool ok = writer_close(writer, file_name);
+    free(writer);
+    if (ok) printf("PNG saved to file: %s\n", file_name);
+    return ok;
+}
+
+#define RASTER_TILE 64
+#define RASTER_BACKGROUND ((Color){200, 200, 200, 255})
+
+// Triangle or thick segment in pixel space. Every edge is a line `dot(n, p) = c`,
+// positive distances point inside.
+typedef struct Shape {
+    Vector2 n[3];
+    float c[3];
+    float half_width;  // segments only, along the segment from 0 to `c[2]`
+    bool segment;
+    uint8_t smooth;    // triangle edges lying on the outline get anti-aliased, inner ones are hard
+    Color color;
+    int x0, y0, x1, y1;
+} Shape;
+
+typedef struct Shapes {
+    Shape *items;
+    size_t count;
+    size_t capacity;
+} Shapes;
+
+typedef struct Raster {
+    Color *pixels;
+    int width;
+    int height;
+    Shapes shapes;
+    // Shapes touching every tile, in drawing order
+    Indeces *tiles;
+    int tiles_x;
+    int tiles_y;
+    atomic_size_t next_tile;
+} Raster;
+
+static inline float clamp01(float v) { return v < 0 ? 0 : (v > 1 ? 1 : v); }
+
+static void shape_bounds(Shape *shape, const Raster *raster, float x0, float y0, float x1, float y1) {
+    shape->x0 = clamp_i((int)floorf(x0), 0, raster->width - 1);
+    shape->y0 = clamp_i((int)floorf(y0), 0, raster->height - 1);
+    shape->x1 = clamp_i((int)ceilf(x1), 0, raster->width - 1);
+    shape->y1 = clamp_i((int)ceilf(y1), 0, raster->height - 1);
+}
+
+// Same as DrawLineEx: a rectangle of the given thickness with flat ends
+static void raster_segment(Raster *raster, Vector2 a, Vector2 b, float thickness, Color color) {
+    Vector2 ab = sub_v2(b, a);
+    float len = len_v2(ab);
+    if (len == 0) return;
+    Vector2 dir = scale_v2(ab, 1.0f / len);
+    Vector2 perp = {-dir.y, dir.x};
+    Shape shape = {
+        .n = {dir, perp},
+        .c = {dir.x * a.x + dir.y * a.y, perp.x * a.x + perp.y * a.y, len},
+        .half_width = thickness / 2,
+        .segment = true,
+        .color = color,
+    };
+    float pad = thickness / 2 + 1;
+    shape_bounds(&shape, raster, fminf(a.x, b.x) - pad, fminf(a.y, b.y) - pad, fmaxf(a.x, b.x) + pad, fmaxf(a.y, b.y) + pad);
+    DA_APPEND(&raster->shapes, shape);
+}
+
+static void raster_triangle(Raster *raster, Vector2 a, Vector2 b, Vector2 c, uint8_t smooth, Color color) {
+    Vector2 p[3] = {a, b, c};
+    float orientation = cross_v2(sub_v2(b, a), sub_v2(c, a)) > 0 ? 1.0f : -1.0f;
+    Shape shape = {.smooth=smooth, .color=color};
+    for (int i = 0; i < 3; i++) {
+        Vector2 e = sub_v2(p[(i + 1) % 3], p[i]);
+        float len = len_v2(e);
+        if (len == 0) return;
+        shape.n[i] = scale_v2((Vector2){-e.y, e.x}, orientation / len);
+        shape.c[i] = shape.n[i].x * p[i].x + shape.n[i].y * p[i].y;
+    }
+    shape_bounds(&shape, raster,
+                 fminf(a.x, fminf(b.x, c.x)) - 1, fminf(a.y, fminf(b.y, c.y)) - 1,
+                 fmaxf(a.x, fmaxf(b.x, c.x)) + 1, fmaxf(a.y, fmaxf(b.y, c.y)) + 1);
+    DA_APPEND(&raster->shapes, shape);
+}
+
+// Fraction of the pixel centered at `p` covered by the shape, estimated from the distance to its edges
+static float shape_coverage(const Shape *shape, Vector2 p) {
+    if (shape->segment) {
+        float along = shape->n[0].x * p.x + shape->n[0].y * p.y - shape->c[0];
+        float across = fabsf(shape->n[1].x * p.x + shape->n[1].y * p.y - shape->c[1]);
+        float outside = fmaxf(fmaxf(-along, along - shape->c[2]), across - shape->half_width);
+        return clamp01(0.5f - outside);
+    }
+    float coverage = 1.0f;
+    for (int i = 0; i < 3; i++) {
+        float d = shape->n[i].x * p.x + shape->n[i].y * p.y - shape->c[i];
+        if (shape->smooth & (1 << i)) {
+            coverage = fminf(coverage, clamp01(0.5f + d));
+        } else if (!(d > 0 || (d == 0 && (shape->n[i].x > 0 || (shape->n[i].x == 0 && shape->n[i].y > 0))))) {
+            // Hard edge shared with a neighbour, the tie goes to exactly one of them
+            return 0;
+        }
+    }
+    return coverage;
+}
+
+static inline void blend(Color *dst, Color src, float coverage) {
+    float a = src.a / 255.0f * coverage;
+    dst->r = (unsigned char)(dst->r + (src.r - dst->r) * a + 0.5f);
+    dst->g = (unsigned char)(dst->g + (src.g - dst->g) * a + 0.5f);
+    dst->b = (unsigned char)(dst->b + (src.b - dst->b) * a + 0.5f);
+    dst->a = (unsigned char)(dst->a + (255 - dst->a) * a + 0.5f);
+}
+
+static void *raster_worker(void *arg) {
+    Raster *raster = arg;
+    size_t tiles_count = (size_t)raster->tiles_x * raster->tiles_y;
+    for (;;) {
+        size_t t = atomic_fetch_add(&raster->next_tile, 1);
+        if (t >= tiles_count) break;
+        int tx0 = (int)(t % raster->tiles_x) * RASTER_TILE;
+        int ty0 = (int)(t / raster->tiles_x) * RASTER_TILE;
+        int tx1 = tx0 + RASTER_TILE - 1 < raster->width ? tx0 + RASTER_TILE - 1 : raster->width - 1;
+        int ty1 = ty0 + RASTER_TILE - 1 < raster->height ? ty0 + RASTER_TILE - 1 : raster->height - 1;
+
+        for (int y = ty0; y <= ty1; y++) {
+            for (int x = tx0; x <= tx1; x++) raster->pixels[(size_t)y * raster->width + x] = RASTER_BACKGROUND;
+        }
+
+        const Indeces *tile = &raster->tiles[t];
+        for (size_t k = 0; k < tile->count; k++) {
+            const Shape *shape = &raster->shapes.items[tile->items[k]];
+            int y0 = shape->y0 > ty0 ? shape->y0 : ty0, y1 = shape->y1 < ty1 ? shape->y1 : ty1;
+            int x0 = shape->x0 > tx0 ? shape->x0 : tx0, x1 = shape->x1 < tx1 ? shape->x1 : tx1;
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    float coverage = shape_coverage(shape, (Vector2){x + 0.5f, y + 0.5f});
+                    if (coverage > 0) blend(&raster->pixels[(size_t)y * raster->width + x], shape->color, coverage);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+static size_t outline_index(const Polygon2 *polygon, Vector2 p) {
+    for (size_t i = 0; i < polygon->count; i++) {
+        if (same_v2(polygon->items[i], p)) return i;
+    }
+    return polygon->count;
+}
+
+// STOPPED stage picture drawn on CPU: `view` rectangle of the world is stretched over the whole
+// image, tiles are shared between `threads_count` threads
+static void render_leaf(Color *pixels, int width, int height, Rectangle view,
+                        const Polygon2 *polygon, const LeaferTriangles *vertices, const LeaferTree *tree, size_t threads_count) {
+    Raster raster = {.pixels=pixels, .width=width, .height=height};
+    float scale = width / view.width;
+    Vector2 offset = {view.x, view.y};
+#define TO_PIXEL(p) scale_v2(sub_v2((p), offset), scale)
+
+    for (size_t i = 0; i < vertices->count; i++) {
+        const LeaferTriangle *t = &vertices->items[i];
+        // Only edges between neighbouring outline points are the real border of the blade
+        size_t idx[3] = {outline_index(polygon, t->a), outline_index(polygon, t->b), outline_index(polygon, t->c)};
+        uint8_t smooth = 0;
+        for (int e = 0; e < 3; e++) {
+            size_t u = idx[e], v = idx[(e + 1) % 3];
+            if (u < polygon->count && v < polygon->count &&
+                ((u + 1) % polygon->count == v || (v + 1) % polygon->count == u)) smooth |= 1 << e;
+        }
+        raster_triangle(&raster, TO_PIXEL(t->a), TO_PIXEL(t->b), TO_PIXEL(t->c), smooth, LEAFER_COLOR_FILL);
+    }
+
+    for (size_t i = 0; i < polygon->count; i++) {
+        raster_segment(&raster, TO_PIXEL(polygon->items[i]), TO_PIXEL(polygon->items[(i + 1) % polygon->count]), 3.0f * scale, LEAFER_COLOR_OUTLINE);
+    }
+
+    for (size_t i = 0; i < tree->count; i++) {
+        const LeaferBranch *v = &tree->items[i];
+        for (size_t j = 0; j + 1 < v->count; j++) {
+            raster_segment(&raster, TO_PIXEL(v->items[j]), TO_PIXEL(v->items[j + 1]), v->widths[j] * scale,
+                           lerp_color(LEAFER_COLOR_VEIN1, LEAFER_COLOR_VEIN2, vein_shade(v->widths[j])));
+        }
+    }
+#undef TO_PIXEL
+
+    raster.tiles_x = (width + RASTER_TILE - 1) / RASTER_TILE;
+    raster.tiles_y = (height + RASTER_TILE - 1) / RASTER_TILE;
+    raster.tiles = calloc((size_t)raster.tiles_x * raster.tiles_y, sizeof(Indeces));
+    assert(raster.tiles && "render_leaf: calloc failed");
+    for (size_t i = 0; i < raster.shapes.count; i++) {
+        const Shape *shape = &raster.shapes.items[i];
+        for (int ty = shape->y0 / RASTER_TILE; ty <= shape->y1 / RASTER_TILE; ty++) {
+            for (int tx = shape->x0 / RASTER_TILE; tx <= shape->x1 / RASTER_TILE; tx++) {
+                DA_APPEND(&raster.tiles[ty * raster.tiles_x + tx], i);
+            }
+        }
+    }
+
+    atomic_init(&raster.next_tile, 0);
+    pthread_t *threads = malloc(sizeof(*threads) * threads_count);
+    assert(threads && "render_leaf: malloc failed");
+    size_t started = 0;
+    for (; started + 1 < threads_count; started++) {
+        if (pthread_create(&threads[started], NULL, raster_worker, &raster) != 0) break;
+    }
+    raster_worker(&raster); // this thread helps too
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    for (int i = 0; i < raster.tiles_x * raster.tiles_y; i++) {
+        free(raster.tiles[i].items);
+    }
+    free(raster.tiles);
+    free(raster.shapes.items);
+}
+
+// Whole leaf into a PNG `width` pixels wide, height follows the leaf's proportions
+static bool write_leaf_png(const Polygon2 *polygon, const LeaferTriangles *vertices, const LeaferTree *tree, int width, size_t threads_count, const char *file_name) {
+    Rectangle bounds = polygon_bounds(polygon);
+    float margin = 2 * LEAF_VEIN_THCK_END;
+    Rectangle view = {bounds.x - margin, bounds.y - margin, bounds.width + 2 * margin, bounds.height + 2 * margin};
+    int height = (int)ceilf(view.height * width / view.width);
+
+    Color *pixels = malloc(sizeof(Color) * (size_t)width * height);
+    assert(pixels && "write_leaf_png: malloc failed");
+    render_leaf(pixels, width, height, view, polygon, vertices, tree, threads_count);
+    bool ok = write_png_file(pixels, width, height, file_name);
+    free(pixels);
+    return ok;
+}
+
+static void simulation_init(Leafer *sim, const LeaferParams *params, Vector2 seed_coord, uint64_t seed) {
+    *sim = (Leafer){0};
+    sim->params = *params;
+    random_seed(&sim->rng, seed);
+    sim->threads = 1;
+
+    // Leaf outline always starts right under the seed
+    sim->polygon.closed = false;
+    DA_APPEND(&sim->polygon, ((Vector2){seed_coord.x, seed_coord.y + 3 * params->vein_radius}));
+
+    // Several first nodes
+    size_t gen = GEN_START;
+    Node vein1 = {
+        .center=(Vector2){seed_coord.x, seed_coord.y + params->vein_radius},
+        .radius=params->vein_radius,
+        .closest_source_indeces=(Indeces){0},
+        .parent=(Vector2){-1,-1},
+        .gen=gen++,
+    };
+    DA_APPEND(&sim->veins, vein1);
+
+    Node vein2 = {
+        .center=(Vector2){seed_coord.x, seed_coord.y - params->vein_radius},
+        .radius=params->vein_radius,
+        .closest_source_indeces=(Indeces){0},
+        .parent=sim->veins.items[0].center,
+        .gen=gen++,
+    };
+    DA_APPEND(&sim->veins, vein2);
+
+    sim->gen = gen;
+    sim->origin = seed_coord;
+    sim->scale = 1.0f;
+}
+
+static inline Vector2 scale_about(Vector2 p, Vector2 origin, float s) {
+    return add_v2(origin, scale_v2(sub_v2(p, origin), s));
+}
+
+// Polygon got closed, prepare everything the growth needs. With `spill_file` the leaf grows out of core:
+// finished tiles are written there and dropped from memory.
+static bool simulation_start(Leafer *sim, const char *spill_file) {
+    simplify_polyline(sim->polygon.items, NULL, &sim->polygon.count, true, sim->params.simplify_outline);
+    sim->polygon.closed = true;
+    sim->outline = (Polygon2){0};
+    for (size_t i = 0; i < sim->polygon.count; i++) {
+        DA_APPEND(&sim->outline, sim->polygon.items[i]);
+    }
+    sim->outline.closed = true;
+
+    // With marginal growth the blade starts small around the seed and expands up to the drawn outline
+    sim->scale = sim->params.growth_rate > 0 ? sim->params.growth_start : 1.0f;
+    for (size_t i = 0; i < sim->polygon.count; i++) {
+        sim->polygon.items[i] = scale_about(sim->outline.items[i], sim->origin, sim->scale);
+    }
+
+    sim->bounds = polygon_bounds(&sim->polygon);
+    polygon_edges_build(&sim->edges, &sim->polygon);
+
+    // Decomposed at full size, the shrunk blade gets too thin for ear clipping. Pieces are outline indeces,
+    // so they fit the blade at any scale.
+    if (!decompose_polygon(&sim->decomposition, &sim->outline, &sim->scratch)) {
+        printf("Can't split the outline into convex pieces\n");
+        return false;
+    }
+    sim->node_pieces.count = 0;
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        DA_APPEND(&sim->node_pieces, locate_piece(&sim->decomposition, &sim->edges, sim->veins.items[i].center));
+    }
+
+    reserve_auxins(&sim->auxins, sim->params.auxin_spray_threshold);
+    grid_init(&sim->grid, &sim->outline, sim->origin, sim->scale, 2 * sim->params.vein_radius);
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        grid_insert(&sim->grid, sim->veins.items[i].center, i);
+    }
+
+    if (spill_file) {
+        // Finalised nodes must never move again
+        if (sim->params.growth_rate > 0) {
+            printf("Out of core growth does not work with an expanding blade\n");
+            return false;
+        }
+        // Tiles are sprayed uniformly
+        if (sim->density.count > 0) {
+            printf("Out of core growth does not work with a density map\n");
+            return false;
+        }
+        if (!tiling_init(&sim->tiling, sim->bounds, sim->params.tile_size, spill_file)) return false;
+    }
+    return true;
+}
+
+static bool tile_quiet(const Tiling *tiling, int x, int y, size_t step) {
+    // Nothing grows beyond the border
+    if (x < 0 || y < 0 || x >= tiling->cols || y >= tiling->rows) return true;
+    const Tile *tile = &tiling->items[y * tiling->cols + x];
+    return tile->state != TILE_ACTIVE || step - tile->last_busy >= TILE_QUIET_STEPS;
+}
+
+static bool tile_enclosed(const Tiling *tiling, int index) {
+    int tx = index % tiling->cols, ty = index / tiling->cols;
+    for (int y = ty - 1; y <= ty + 1; y++) {
+        for (int x = tx - 1; x <= tx + 1; x++) {
+            if (x < 0 || y < 0 || x >= tiling->cols || y >= tiling->rows) continue;
+            if (tiling->items[y * tiling->cols + x].state != TILE_FINALISED) return false;
+        }
+    }
+    return true;
+}
+
+// Growth front of the step: tiles with live auxins or nodes created after `first_new`
+static void mark_busy_tiles(Leafer *sim, size_t first_new) {
+    Tiling *tiling = &sim->tiling;
+    for (size_t i = 0; i < sim->auxins.count; i++) {
+        if (!auxin_alive(&sim->auxins, i)) continue;
+        tiling->items[tile_at(tiling, sim->auxins.items[i].center)].last_busy = sim->step;
+    }
+    for (size_t i = first_new; i < sim->veins.count; i++) {
+        tiling->items[tile_at(tiling, sim->veins.items[i].center)].last_busy = sim->step;
+    }
+}
+
+// Tiles that stayed quiet together with their neighbours are finalised: their nodes go to the spill
+// file. Finalised nodes stay in memory for as long as some tile around them is active, afterwards
+// nothing can come close enough to them to matter and they are dropped.
+static void flush_tiles(Leafer *sim) {
+    Tiling *tiling = &sim->tiling;
+    bool any = false;
+    for (int y = 0; y < tiling->rows; y++) {
+        for (int x = 0; x < tiling->cols; x++) {
+            Tile *tile = &tiling->items[y * tiling->cols + x];
+            if (tile->state != TILE_ACTIVE) continue;
+            bool quiet = true;
+            for (int ny = y - 1; ny <= y + 1 && quiet; ny++) {
+                for (int nx = x - 1; nx <= x + 1 && quiet; nx++) {
+                    quiet = tile_quiet(tiling, nx, ny, sim->step);
+                }
+            }
+            if (quiet) {
+                tile->state = TILE_FINALISING;
+                any = true;
+            }
+        }
+    }
+    if (!any) return;
+
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        const Node *node = &sim->veins.items[i];
+        if (tiling->items[tile_at(tiling, node->center)].state != TILE_FINALISING) continue;
+        if (fwrite(node, sizeof(Node), 1, tiling->spill) != 1) {
+            printf("Can't write a veins node to spill file\n");
+            continue;
+        }
+        tiling->spilled++;
+    }
+    tiling->active.count = 0;
+    for (size_t i = 0; i < (size_t)tiling->cols * tiling->rows; i++) {
+        if (tiling->items[i].state == TILE_FINALISING) tiling->items[i].state = TILE_FINALISED;
+        if (tiling->items[i].state == TILE_ACTIVE) DA_APPEND(&tiling->active, i);
+    }
+
+    // Drop nodes with nothing active around and give the memory back
+    size_t kept = 0;
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        Node *node = &sim->veins.items[i];
+        if (tile_enclosed(tiling, tile_at(tiling, node->center))) continue;
+        sim->node_pieces.items[kept] = sim->node_pieces.items[i];
+        sim->veins.items[kept++] = *node;
+    }
+    if (kept == sim->veins.count) return;
+    sim->veins.count = kept;
+    sim->node_pieces.count = kept;
+    if (sim->veins.capacity > 16 && kept < sim->veins.capacity / 4) {
+        sim->veins.capacity = kept * 2 > 16 ? kept * 2 : 16;
+        sim->veins.items = realloc(sim->veins.items, sizeof(Node) * sim->veins.capacity);
+        assert(sim->veins.items && "flush_tiles: realloc failed");
+    }
+
+    // Node indeces have moved, refill the grid
+    NodeGrid *grid = &sim->grid;
+    for (int i = 0; i < grid->cols * grid->rows; i++) {
+        grid->cells[i].count = 0;
+    }
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        grid_insert(grid, sim->veins.items[i].center, i);
+    }
+    for (int i = 0; i < grid->cols * grid->rows; i++) {
+        if (grid->cells[i].count > 0) continue;
+        free(grid->cells[i].items);
+        grid->cells[i] = (Indeces){0};
+    }
+}
+
+// Nodes of the whole leaf. Ones of finalised tiles stay in memory until their tile is enclosed, but they're
+// in the spill file already.
+static size_t leaf_node_count(const Leafer *sim) {
+    size_t count = sim->tiling.spilled;
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        if (!tile_finalised(&sim->tiling, sim->veins.items[i].center)) count++;
+    }
+    return count;
+}
+
+// Veins file of the whole leaf, spilled nodes go first followed by the ones still in memory
+bool leafer_write_veins(const Leafer *sim, const char *file_name) {
+    const Tiling *tiling = &sim->tiling;
+    if (!tiling->spill) return write_veins_file(&sim->veins, file_name);
+
+    FILE *file_desc = fopen(file_name, "wb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    size_t count = leaf_node_count(sim);
+    if (fwrite(&count, sizeof(count), 1, file_desc) != 1) {
+        printf("Can't write amount of veins nodes to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+
+    bool ok = fflush(tiling->spill) == 0 && fseek(tiling->spill, 0, SEEK_SET) == 0;
+    Node chunk[1024];
+    for (size_t left = tiling->spilled; ok && left > 0;) {
+        size_t n = left < 1024 ? left : 1024;
+        ok = fread(chunk, sizeof(Node), n, tiling->spill) == n && fwrite(chunk, sizeof(Node), n, file_desc) == n;
+        left -= n;
+    }
+    fseek(tiling->spill, 0, SEEK_END);
+    for (size_t i = 0; ok && i < sim->veins.count; i++) {
+        if (tile_finalised(tiling, sim->veins.items[i].center)) continue;
+        ok = fwrite(&sim->veins.items[i], sizeof(Node), 1, file_desc) == 1;
+    }
+    if (!ok) {
+        printf("Can't write a veins nodes to file: %s\n", file_name);
+        fclose(file_desc);
+        return false;
+    }
+
+    if (fclose(file_desc) != 0) {
+        printf("Can't close file: %s\n", file_name);
+        return false;
+    }
+    printf("Veins saved to file: %s\n", file_name);
+    return true;
+}
+
+// Whole leaf in memory again: spilled nodes are read back followed by the ones still in memory
+static bool read_spilled_veins(const Leafer *sim, Veins *veins) {
+    const Tiling *tiling = &sim->tiling;
+    veins->capacity = tiling->spilled + sim->veins.count;
+    veins->items = malloc(sizeof(Node) * veins->capacity);
+    assert(veins->items && "read_spilled_veins: malloc failed");
+    bool ok = fflush(tiling->spill) == 0 && fseek(tiling->spill, 0, SEEK_SET) == 0 &&
+              fread(veins->items, sizeof(Node), tiling->spilled, tiling->spill) == tiling->spilled;
+    fseek(tiling->spill, 0, SEEK_END);
+    if (!ok) {
+        printf("Can't read veins nodes back from spill file\n");
+        return false;
+    }
+    veins->count = tiling->spilled;
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        if (!tile_finalised(tiling, sim->veins.items[i].center)) DA_APPEND(veins, sim->veins.items[i]);
+    }
+    return true;
+}
+
+// Marginal growth: relative blade expansion for the next step, 1 once the blade reached its drawn size
+static float blade_growth(const LeaferParams *params, float scale) {
+    if (params->growth_rate <= 0 || scale >= 1.0f) return 1.0f;
+    float factor = 1.0f + params->growth_rate;
+    if (scale * factor > 1.0f) factor = 1.0f / scale;
+    return factor;
+}
+
+// Expand the blade with everything on it. Radii stay the same, so space for new auxins appears between
+// the existing nodes. Node grid lives in blade coordinates and only needs the new scale.
+static void expand_blade(Leafer *sim) {
+    float factor = blade_growth(&sim->params, sim->scale);
+    if (factor == 1.0f) return;
+
+    sim->scale = fminf(sim->scale * factor, 1.0f);
+    sim->grid.scale = sim->scale;
+    // Outline is recalculated from the drawn one so that it ends exactly where it was drawn
+    for (size_t i = 0; i < sim->polygon.count; i++) {
+        sim->polygon.items[i] = scale_about(sim->outline.items[i], sim->origin, sim->scale);
+    }
+    sim->bounds = polygon_bounds(&sim->polygon);
+    polygon_edges_build(&sim->edges, &sim->polygon);
+    // Parents are referenced by position, both sides go through the exact same operation to stay equal
+    for (size_t i = 0; i < sim->veins.count; i++) {
+        Node *node = &sim->veins.items[i];
+        node->center = scale_about(node->center, sim->origin, factor);
+        if (!same_v2(node->parent, (Vector2){-1, -1})) node->parent = scale_about(node->parent, sim->origin, factor);
+    }
+    for (size_t i = 0; i < sim->auxins.count; i++) {
+        sim->auxins.items[i].center = scale_about(sim->auxins.items[i].center, sim->origin, factor);
+    }
+}
+
+static void simulation_free(Leafer *sim) {
+    free(sim->veins.items);
+    free(sim->node_pieces.items);
+    free_auxins(&sim->auxins);
+    free(sim->polygon.items);
+    free(sim->outline.items);
+    grid_free(&sim->grid);
+    tiling_free(&sim->tiling);
+    decomposition_free(&sim->decomposition);
+    polygon_edges_free(&sim->edges);
+    density_free(&sim->density);
+    free_space_free(&sim->free_space);
+    spray_pool_stop(&sim->pool);
+    scratch_free(&sim->scratch);
+    *sim = (Leafer){0};
+}
+
+// Auxins sprayed during `step` that are still alive
+static size_t count_fresh_auxins(const Auxins *auxins, size_t step) {
+    size_t count = 0;
+    for (size_t i = 0; i < auxins->count; i++) {
+        if (auxin_alive(auxins, i) && auxins->items[i].born == step) count++;
+    }
+    return count;
+}
+
+double leafer_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Grow until the growth stops or the clock passes `deadline`, true once it has stopped.
+// Steps can be left half done in between, auxin loops pause every STEP_SLICE auxins.
+static bool simulation_advance(Leafer *sim, double deadline) {
+    while (sim->stop == LEAFER_STOP_NONE) {
+        switch (sim->stage) {
+            case STEP_SPRAY: {
+                // Every tile is finished when growing out of core
+                if (sim->tiling.spill && sim->tiling.active.count == 0) {
+                    sim->stop = LEAFER_STOP_TILES;
+                    return true;
+                }
+                sim->step++;
+
+                // Temporary arrays of the previous step are gone, a warm scratch serves the whole step from its block
+                sim->heap_allocs = sim->scratch.heap_allocs;
+                scratch_reset(&sim->scratch);
+
+                // 0. Blade expansion in marginal growth mode
+                expand_blade(sim);
+                // Free space is tracked from the moment the blade stops expanding, nodes cover less and less of it before.
+                // Out of core growth keeps to its tiles, a grid over the whole blade would defeat it.
+                if (!sim->free_space.slots && sim->scale >= 1.0f && !sim->tiling.spill) {
+                    free_space_init(&sim->free_space, sim->bounds, &sim->edges, sim->params.auxin_radius);
+                    for (size_t i = 0; i < sim->veins.count; i++) {
+                        free_space_cover(&sim->free_space, &sim->decomposition, &sim->edges, &sim->veins.items[i],
+                                         sim->node_pieces.items[i], sim->params.auxin_radius);
+                    }
+                }
+
+                // 1. If number of auxin is lower then spray threshold -> spray more
+                size_t alive = sim->auxins.alive_count;
+                spray_auxins(&sim->auxins, &sim->edges, &sim->params, &sim->rng, sim->bounds, &sim->density, &sim->free_space, &sim->tiling, &sim->decomposition,
+                             sim->step, &sim->pool, sim->threads, &sim->scratch);
+                sim->sprayed = sim->auxins.alive_count - alive;
+                sim->stage = STEP_ELIMINATE;
+                sim->cursor = 0;
+            } break;
+            case STEP_ELIMINATE: {
+                // 2. Remove auxins which radius fits in any vein's center
+                size_t end = sim->cursor + STEP_SLICE < sim->auxins.count ? sim->cursor + STEP_SLICE : sim->auxins.count;
+                eliminate_auxins(&sim->auxins, &sim->veins, sim->node_pieces.items, &sim->grid, &sim->edges, &sim->decomposition, sim->cursor, end);
+                sim->cursor = end;
+                if (end < sim->auxins.count) break;
+                sim->uncovered = sim->sprayed ? count_fresh_auxins(&sim->auxins, sim->step) : 0;
+                sim->stage = STEP_ASSOCIATE;
+                sim->cursor = 0;
+            } break;
+            case STEP_ASSOCIATE: {
+                // 3. Associate each auxin with vein node that is closes to it
+                size_t end = sim->cursor + STEP_SLICE < sim->auxins.count ? sim->cursor + STEP_SLICE : sim->auxins.count;
+                associate_auxins(&sim->auxins, &sim->veins, sim->node_pieces.items, &sim->grid, &sim->edges, &sim->decomposition, sim->cursor, end);
+                sim->cursor = end;
+                if (end < sim->auxins.count) break;
+                link_auxins(&sim->auxins, &sim->veins, &sim->scratch);
+                sim->stage = STEP_PRODUCE;
+            } break;
+            case STEP_PRODUCE: {
+                size_t reachable = sim->uncovered ? count_fresh_auxins(&sim->auxins, sim->step) : 0;
+
+                // 4. Construct normalized vectors from the vein node to each associated auzin source.
+                // Sum constructed vectors and normalize it again -> calculate location of new node and add them
+                size_t first_new = sim->veins.count;
+                produce_new_nodes(&sim->auxins, &sim->edges, &sim->params, &sim->veins, &sim->node_pieces, &sim->grid, &sim->tiling, &sim->decomposition, sim->gen, &sim->scratch);
+                if (sim->tiling.spill) mark_busy_tiles(sim, first_new);
+                for (size_t i = first_new; i < sim->veins.count && sim->free_space.slots; i++) {
+                    free_space_cover(&sim->free_space, &sim->decomposition, &sim->edges, &sim->veins.items[i],
+                                         sim->node_pieces.items[i], sim->params.auxin_radius);
+                }
+                // Nodes and their grid cells still grow with the leaf, that's the result and not per step traffic
+                assert((sim->step <= SCRATCH_WARMUP_STEPS || sim->scratch.heap_allocs == sim->heap_allocs) &&
+                       "Scratch memory grew after warm-up");
+                assert(sim->auxins.capacity <= sim->params.auxin_spray_threshold && "Auxin slots outgrew their reservation");
+                sim->stage = STEP_SPRAY;
+
+                if (sim->veins.count > first_new) sim->gen++;
+
+                // Growth is over when for a while nothing new has grown and every new auxin died right away.
+                // Without any spraying live auxins are all stuck, unless no free space is left to spray into,
+                // otherwise the leaf is as covered as it gets.
+                // Expanding blade keeps making room for new nodes, so it can't stop before reaching full size.
+                if (sim->veins.count > first_new || reachable > 0 || sim->scale < 1.0f) {
+                    sim->quiet_steps = 0;
+                    sim->quiet_sprayed = 0;
+                    sim->quiet_covered = 0;
+                    sim->quiet_unreachable = 0;
+                } else {
+                    sim->quiet_steps++;
+                    sim->quiet_sprayed += sim->sprayed;
+                    sim->quiet_covered += sim->sprayed - sim->uncovered;
+                    sim->quiet_unreachable += sim->uncovered;
+                    if (sim->quiet_steps >= sim->params.converge_steps) {
+                        sim->stop = sim->quiet_sprayed > 0 || free_space_full(&sim->free_space) ? LEAFER_STOP_SATURATED : LEAFER_STOP_STUCK;
+                        return true;
+                    }
+                }
+
+                if (sim->tiling.spill && sim->step % TILE_FLUSH_STEPS == 0) flush_tiles(sim);
+            } break;
+        }
+        if (deadline < INFINITY && leafer_now() >= deadline) return false;
+    }
+    return true;
+}
+
+static const char *stop_reason_name(LeaferStop stop) {
+    switch (stop) {
+        case LEAFER_STOP_NONE:      return "still growing";
+        case LEAFER_STOP_SATURATED: return "new auxins land only on covered or unreachable blade";
+        case LEAFER_STOP_STUCK:     return "no node can grow towards the live auxins";
+        case LEAFER_STOP_TILES:     return "every tile is finalised";
+    }
+    return "unknown";
+}
+
+// Auxins sprayed during the last quiet steps sample the blade, their fate tells what's left of it
+void leafer_report(const Leafer *sim, const char *label) {
+    float area = 0;
+    for (size_t i = 0; i < sim->polygon.count; i++) {
+        area += cross_v2(sim->polygon.items[i], sim->polygon.items[(i + 1) % sim->polygon.count]);
+    }
+    area = fabsf(area) / 2;
+    printf("%s: stopped after %zu steps, %s. %zu nodes, %zu stuck auxins",
+           label, sim->step, stop_reason_name(sim->stop), leaf_node_count(sim), sim->auxins.alive_count);
+    // With free space tracked the auxins only sample what's left of it
+    const FreeSpace *space = &sim->free_space;
+    float sampled = space->slots ? fminf((float)space->count * space->cell_size * space->cell_size, area) : area;
+    if (sim->quiet_sprayed > 0) {
+        float covered = 1 - (1 - (float)sim->quiet_covered / (float)sim->quiet_sprayed) * sampled / area;
+        float unreachable = (float)sim->quiet_unreachable / (float)sim->quiet_sprayed;
+        printf(", covered ~%.0f%%, unreachable ~%.0f of %.0f area", 100 * covered, unreachable * sampled, area);
+    }
+    if (space->slots) printf(", free cells ~%.0f", sampled);
+    printf("\n");
+}
+
+void leafer_free_tree(LeaferTree *tree) {
+    for (size_t i = 0; i < tree->count; i++) {
+        free(tree->items[i].items);
+        free(tree->items[i].widths);
+    }
+    free(tree->items);
+    *tree = (LeaferTree){0};
+}
+
+bool leafer_parse_param(LeaferParams *params, const char *name, const char *value) {
+    char *end = NULL;
+    if      (strcmp(name, "vein_radius") == 0)           params->vein_radius = strtof(value, &end);
+    else if (strcmp(name, "vein_radius_min") == 0)       params->vein_radius_min = strtof(value, &end);
+    else if (strcmp(name, "toleration_ratio") == 0)      params->toleration_ratio = strtof(value, &end);
+    else if (strcmp(name, "auxin_radius") == 0)          params->auxin_radius = strtof(value, &end);
+    else if (strcmp(name, "auxin_spray_threshold") == 0) params->auxin_spray_threshold = strtoull(value, &end, 10);
+    else if (strcmp(name, "converge_steps") == 0)        params->converge_steps = strtoull(value, &end, 10);
+    else if (strcmp(name, "growth_rate") == 0)           params->growth_rate = strtof(value, &end);
+    else if (strcmp(name, "growth_start") == 0)          params->growth_start = strtof(value, &end);
+    else if (strcmp(name, "tile_size") == 0)             params->tile_size = strtof(value, &end);
+    else if (strcmp(name, "simplify_veins") == 0)        params->simplify_veins = strtof(value, &end);
+    else if (strcmp(name, "simplify_outline") == 0)      params->simplify_outline = strtof(value, &end);
+    else return false;
+    return end != value && *end == '\0';
+}
+
+// Library interface, see leafer.h
+
+LeaferParams leafer_default_params(void) {
+    return DEFAULT_PARAMS;
+}
+
+Leafer *leafer_create(const LeaferParams *params, Vector2 seed, uint64_t random_seed) {
+    Leafer *leafer = malloc(sizeof(*leafer));
+    assert(leafer && "leafer_create: malloc failed");
+    simulation_init(leafer, params, seed, random_seed);
+    return leafer;
+}
+
+void leafer_destroy(Leafer *leafer) {
+    if (!leafer) return;
+    simulation_free(leafer);
+    free(leafer);
+}
+
+void leafer_set_threads(Leafer *leafer, size_t threads) {
+    leafer->threads = threads > 0 ? threads : 1;
+    // Started again with the new count when needed
+    spray_pool_stop(&leafer->pool);
+}
+
+// Edge from the last point of the outline to `point` may not cross it or pass by the first nodes around `origin`
+static bool outline_edge_valid(const Polygon2 *polygon, Vector2 origin, float vein_radius, Vector2 point) {
+    Vector2 last = polygon->items[polygon->count - 1];
+    if (same_v2(last, point)) return false;
+    if (distance_v2(last, point, origin, true) <= 2 * vein_radius) return false;
+    return !segment_intersect_polygon(last, point, polygon);
+}
+
+// Outline that could have been drawn point by point and closed
+static bool outline_valid(const Polygon2 *outline, Vector2 origin, float vein_radius) {
+    Polygon2 drawn = (Polygon2){.items=outline->items, .count=1};
+    for (; drawn.count < outline->count; drawn.count++) {
+        if (!outline_edge_valid(&drawn, origin, vein_radius, outline->items[drawn.count])) return false;
+    }
+    return drawn.count >= 3 && outline_edge_valid(&drawn, origin, vein_radius, outline->items[0]);
+}
+
+bool leafer_outline_accepts(const Leafer *leafer, Vector2 point) {
+    return outline_edge_valid(&leafer->polygon, leafer->origin, leafer->params.vein_radius, point);
+}
+
+bool leafer_outline_add(Leafer *leafer, Vector2 point) {
+    if (!leafer_outline_accepts(leafer, point)) return false;
+    DA_APPEND(&leafer->polygon, point);
+    return true;
+}
+
+void leafer_outline_undo(Leafer *leafer) {
+    // First point belongs to the seed
+    if (leafer->polygon.count > 1) leafer->polygon.count--;
+}
+
+bool leafer_outline_closes(const Leafer *leafer) {
+    return leafer->polygon.count >= 3 && leafer_outline_accepts(leafer, leafer->polygon.items[0]);
+}
+
+// Takes the outline over. Seed and the first nodes move so that the outline still starts right under the seed.
+static void replace_outline(Leafer *leafer, Polygon2 outline) {
+    Vector2 offset = sub_v2(outline.items[0], leafer->polygon.items[0]);
+    for (size_t i = 0; i < leafer->veins.count; i++) {
+        Node *node = &leafer->veins.items[i];
+        node->center = add_v2(node->center, offset);
+        if (!same_v2(node->parent, (Vector2){-1, -1})) node->parent = add_v2(node->parent, offset);
+    }
+    leafer->origin = add_v2(leafer->origin, offset);
+    free(leafer->polygon.items);
+    leafer->polygon = outline;
+}
+
+bool leafer_read_outline(Leafer *leafer, const char *file_name) {
+    Polygon2 outline = (Polygon2){0};
+    if (!read_polygon_file(&outline, file_name) || outline.count < 3) {
+        free(outline.items);
+        return false;
+    }
+    // The seed follows the first point, the outline has to keep clear of it there
+    Vector2 origin = add_v2(leafer->origin, sub_v2(outline.items[0], leafer->polygon.items[0]));
+    if (!outline_valid(&outline, origin, leafer->params.vein_radius)) {
+        printf("Outline crosses itself or passes too close by itself or the seed: %s\n", file_name);
+        free(outline.items);
+        return false;
+    }
+    replace_outline(leafer, outline);
+    return true;
+}
+
+bool leafer_write_outline(const Leafer *leafer, const char *file_name) {
+    return write_polygon_file(&leafer->polygon, file_name);
+}
+
+const Vector2 *leafer_outline(const Leafer *leafer, size_t *count) {
+    *count = leafer->polygon.count;
+    return leafer->polygon.items;
+}
+
+bool leafer_start(Leafer *leafer, const char *spill_file) {
+    return simulation_start(leafer, spill_file);
+}
+
+bool leafer_advance(Leafer *leafer, double deadline) {
+    return simulation_advance(leafer, deadline);
+}
+
+bool leafer_step(Leafer *leafer) {
+    // Rest of the step in progress, or a whole new one when it is done
+    size_t step = leafer->stage == STEP_SPRAY ? leafer->step + 1 : leafer->step;
+    while (leafer->stop == LEAFER_STOP_NONE && !(leafer->step == step && leafer->stage == STEP_SPRAY)) {
+        simulation_advance(leafer, 0);
+    }
+    return leafer->stop != LEAFER_STOP_NONE;
+}
+
+bool leafer_set_density(Leafer *leafer, const uint8_t *values, int width, int height) {
+    if (leafer->polygon.closed) {
+        printf("Can't change the density of a leaf that already grows\n");
+        return false;
+    }
+    if (width <= 0 || height <= 0 || !density_build(&leafer->density, values, width, height)) {
+        printf("Density map has no cell to spray into\n");
+        return false;
+    }
+    return true;
+}
+
+LeaferStop leafer_stop(const Leafer *leafer) {
+    return leafer->stop;
+}
+
+size_t leafer_node_count(const Leafer *leafer) {
+    return leafer->veins.count;
+}
+
+LeaferNode leafer_node(const Leafer *leafer, size_t index) {
+    assert(index < leafer->veins.count && "leafer_node: index out of range");
+    const Node *node = &leafer->veins.items[index];
+    return (LeaferNode){.center=node->center, .radius=node->radius, .parent=node->parent};
+}
+
+size_t leafer_auxin_slots(const Leafer *leafer) {
+    return leafer->auxins.count;
+}
+
+bool leafer_auxin(const Leafer *leafer, size_t slot, LeaferAuxin *auxin) {
+    if (slot >= leafer->auxins.count || !auxin_alive(&leafer->auxins, slot)) return false;
+    *auxin = (LeaferAuxin){.center=leafer->auxins.items[slot].center, .radius=leafer->auxins.items[slot].radius};
+    return true;
+}
+
+bool leafer_write_veins_compact(const Leafer *leafer, const char *file_name) {
+    if (!leafer->tiling.spill) return write_compact_veins(&leafer->veins, file_name);
+    Veins veins = (Veins){0};
+    bool ok = read_spilled_veins(leafer, &veins) && write_compact_veins(&veins, file_name);
+    free(veins.items);
+    return ok;
+}
+
+bool leafer_read_veins(Leafer *leafer, const char *file_name) {
+    if (leafer->polygon.closed) {
+        printf("Can't read veins into a leaf that already grows: %s\n", file_name);
+        return false;
+    }
+    char magic[4] = {0};
+    FILE *file_desc = fopen(file_name, "rb");
+    if (!file_desc) {
+        printf("Can't open file: %s\n", file_name);
+        return false;
+    }
+    bool compact = fread(magic, 1, sizeof(magic), file_desc) == sizeof(magic) && memcmp(magic, COMPACT_VEINS_MAGIC, 4) == 0;
+    fclose(file_desc);
+
+    Veins veins = (Veins){0};
+    bool ok = compact ? read_compact_veins(&veins, file_name) : read_veins_file(&veins, file_name);
+    if (!ok) {
+        free(veins.items);
+        return false;
+    }
+    free(leafer->veins.items);
+    leafer->veins = veins;
+    return true;
+}
+
+bool leafer_triangulate(Leafer *leafer, LeaferTriangles *triangles, LeaferProgress *progress) {
+    return construct_vertices(triangles, &leafer->polygon, &leafer->scratch, progress);
+}
+
+bool leafer_trace(const Leafer *leafer, LeaferTree *tree, LeaferTree *smooth_tree, LeaferProgress *progress) {
+    // Tree needs every node, spilled ones included
+    Veins spilled = (Veins){0};
+    const Veins *veins = &leafer->veins;
+    if (leafer->tiling.spill) {
+        if (!read_spilled_veins(leafer, &spilled)) {
+            free(spilled.items);
+            return false;
+        }
+        veins = &spilled;
+    }
+    bool ok = traverse_parents(veins, leafer->polygon.items[0], leafer->params.simplify_veins, tree, smooth_tree, progress);
+    free(spilled.items);
+    return ok;
+}
+
+void leafer_free_triangles(LeaferTriangles *triangles) {
+    free(triangles->items);
+    *triangles = (LeaferTriangles){0};
+}
+
+Color leafer_vein_color(float width) {
+    return lerp_color(LEAFER_COLOR_VEIN1, LEAFER_COLOR_VEIN2, vein_shade(width));
+}
+
+bool leafer_write_triangles(const LeaferTriangles *triangles, const char *file_name) {
+    return write_vertices_file(triangles, file_name);
+}
+
+bool leafer_write_svg(const Leafer *leafer, const LeaferTree *tree, const char *file_name) {
+    return write_svg_file(&leafer->polygon, tree, file_name);
+}
+
+bool leafer_write_glb(const Leafer *leafer, const LeaferTriangles *triangles, const LeaferTree *tree, const char *file_name) {
+    LeafMesh mesh = (LeafMesh){0};
+    build_leaf_mesh(&mesh, &leafer->polygon, triangles, tree);
+    bool ok = write_glb_file(&mesh, file_name);
+    free_leaf_mesh(&mesh);
+    return ok;
+}
+
+bool leafer_write_png(const Leafer *leafer, const LeaferTriangles *triangles, const LeaferTree *tree, int width,
+                      size_t threads, const char *file_name) {
+    return write_leaf_png(&leafer->polygon, triangles, tree, width, threads, file_name);
+}
+
+// Leaf archive: many leaves in one append-only file. It starts with ARCHIVE_MAGIC followed by records, each
+// a RecordHeader and its payload, all 8 byte aligned so the payload can be used right from a mapping.
+// Closing appends the index, offsets of every record, and a footer pointing at it. The next writer cuts
+// them off and appends from there, so writers lock the file exclusively and readers shared. Without a footer,
+// after a crash, the index is rebuilt by walking the records and a torn last one is dropped.
+#define ARCHIVE_MAGIC "LEAFSET1"
+#define ARCHIVE_RECORD_MAGIC "LEAF"
+#define ARCHIVE_INDEX_MAGIC "LEAFIDX1"
+#define ARCHIVE_VERSION 2 // of the record payload, params went from a raw struct to field by field
+#define ARCHIVE_PARAMS_SIZE (9 * sizeof(float) + 2 * sizeof(uint64_t))
+
+typedef struct RecordHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t size; // of the payload
+} RecordHeader;
+
+typedef struct ArchiveFooter {
+    uint64_t count;
+    uint64_t index_offset;
+    char magic[8];
+} ArchiveFooter;
+
+typedef struct Offsets {
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} Offsets;
+
+struct LeaferArchive {
+    int fd;
+    bool writing;
+    pthread_mutex_t lock; // appends may come from several threads
+    uint64_t end;         // where the next record goes
+    Offsets offsets;      // index being built, or the walked one of a reader
+    const uint8_t *map;
+    size_t map_size;
+    const uint64_t *index; // offsets of the records, in the mapping when the footer is there
+    size_t count;
+};
+
+static inline void put_bytes(Bytes *out, const void *data, size_t size) {
+    for (size_t i = 0; i < size; i++) DA_APPEND(out, ((const uint8_t *)data)[i]);
+}
+
+static inline void put_u64(Bytes *out, uint64_t value) {
+    put_bytes(out, &value, sizeof(value));
+}
+
+static inline void pad_to_8(Bytes *out) {
+    while (out->count % 8) DA_APPEND(out, 0);
+}
+
+// Field by field in a fixed order, ARCHIVE_PARAMS_SIZE bytes whatever the struct looks like
+static void put_params(Bytes *out, const LeaferParams *params) {
+    float floats_before[] = {params->vein_radius, params->vein_radius_min, params->toleration_ratio, params->auxin_radius};
+    float floats_after[] = {params->growth_rate, params->growth_start, params->tile_size, params->simplify_veins, params->simplify_outline};
+    put_bytes(out, floats_before, sizeof(floats_before));
+    put_u64(out, params->auxin_spray_threshold);
+    put_u64(out, params->converge_steps);
+    put_bytes(out, floats_after, sizeof(floats_after));
+}
+
+static void get_params(const uint8_t *data, LeaferParams *params) {
+    float floats_before[4], floats_after[5];
+    uint64_t threshold, converge_steps;
+    memcpy(floats_before, data, sizeof(floats_before));
+    data += sizeof(floats_before);
+    memcpy(&threshold, data, sizeof(threshold));
+    memcpy(&converge_steps, data + sizeof(threshold), sizeof(converge_steps));
+    data += sizeof(threshold) + sizeof(converge_steps);
+    memcpy(floats_after, data, sizeof(floats_after));
+    *params = (LeaferParams){
+        .vein_radius=floats_before[0],
+        .vein_radius_min=floats_before[1],
+        .toleration_ratio=floats_before[2],
+        .auxin_radius=floats_before[3],
+        .auxin_spray_threshold=threshold,
+        .converge_steps=converge_steps,
+        .growth_rate=floats_after[0],
+        .growth_start=floats_after[1],
+        .tile_size=floats_after[2],
+        .simplify_veins=floats_after[3],
+        .simplify_outline=floats_after[4],
+    };
+}
+
+// Offsets of the whole records from `start` up to `size`, returns where the last whole one ends
+static uint64_t walk_records(const uint8_t *data, uint64_t start, uint64_t size, Offsets *offsets) {
+    uint64_t pos = start;
+    while (pos + sizeof(RecordHeader) <= size) {
+        RecordHeader header;
+        memcpy(&header, data + pos, sizeof(header));
+        if (memcmp(header.magic, ARCHIVE_RECORD_MAGIC, 4) != 0 || header.size % 8) break;
+        if (header.size > size - pos - sizeof(header)) break;
+        DA_APPEND(offsets, pos);
+        pos += sizeof(header) + header.size;
+    }
+    return pos;
+}
+
+// Footer at the end of `size` bytes, false if there is none or it doesn't fit the file
+static bool read_footer(const uint8_t *data, uint64_t size, ArchiveFooter *footer) {
+    if (size < strlen(ARCHIVE_MAGIC) + sizeof(*footer)) return false;
+    memcpy(footer, data + size - sizeof(*footer), sizeof(*footer));
+    if (memcmp(footer->magic, ARCHIVE_INDEX_MAGIC, 8) != 0) return false;
+    return footer->index_offset <= size - sizeof(*footer) && footer->index_offset % 8 == 0 &&
+           footer->count == (size - sizeof(*footer) - footer->index_offset) / sizeof(uint64_t) &&
+           footer->index_offset + footer->count * sizeof(uint64_t) + sizeof(*footer) == size;
+}
+
+// Archive that failed to open, nothing may be written to a file that may not even be an archive
+static void archive_discard(LeaferArchive *archive) {
+    if (archive->writing) pthread_mutex_destroy(&archive->lock);
+    if (archive->map) munmap((void *)archive->map, archive->map_size);
+    close(archive->fd);
+    free(archive->offsets.items);
+    free(archive);
+}
+
+LeaferArchive *leafer_archive_open(const char *file_name) {
+    int fd = open(file_name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        printf("Can't open file: %s\n", file_name);
+        return NULL;
+    }
+    // Other processes wait until this one closes the archive
+    if (flock(fd, LOCK_EX) != 0) {
+        printf("Can't lock file: %s\n", file_name);
+        close(fd);
+        return NULL;
+    }
+    LeaferArchive *archive = calloc(1, sizeof(*archive));
+    assert(archive && "leafer_archive_open: calloc failed");
+    archive->fd = fd;
+    archive->writing = true;
+    pthread_mutex_init(&archive->lock, NULL);
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    size_t size = ok ? (size_t)st.st_size : 0;
+    size_t magic_size = strlen(ARCHIVE_MAGIC);
+    if (ok && size == 0) {
+        ok = pwrite(fd, ARCHIVE_MAGIC, magic_size, 0) == (ssize_t)magic_size;
+        archive->end = magic_size;
+    } else if (ok) {
+        uint8_t *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        ok = data != MAP_FAILED && size >= magic_size && memcmp(data, ARCHIVE_MAGIC, magic_size) == 0;
+        ArchiveFooter footer;
+        if (ok && read_footer(data, size, &footer)) {
+            for (size_t i = 0; i < footer.count; i++) {
+                uint64_t offset;
+                memcpy(&offset, data + footer.index_offset + i * sizeof(offset), sizeof(offset));
+                DA_APPEND(&archive->offsets, offset);
+            }
+            archive->end = footer.index_offset;
+        } else if (ok) {
+            archive->end = walk_records(data, magic_size, size, &archive->offsets);
+        }
+        if (data != MAP_FAILED) munmap(data, size);
+    }
+    if (!ok) {
+        printf("Can't open archive: %s\n", file_name);
+        archive_discard(archive);
+        return NULL;
+    }
+    // Only a checked archive gets cut: its index and anything torn go, records continue right after the last whole one
+    if (size > 0 && ftruncate(fd, archive->end) != 0) {
+        printf("Can't open archive: %s\n", file_name);
+        archive_discard(archive);
+        return NULL;
+    }
+    return archive;
+}
+
+// Record payload: seed, parameters, outline, triangles and compact veins, each count or size first
+bool leafer_archive_append(LeaferArchive *archive, const Leafer *leafer, uint64_t seed, const LeaferTriangles *triangles) {
+    assert(archive->writing && "leafer_archive_append: archive is open for reading");
+    Veins spilled = (Veins){0};
+    const Veins *veins = &leafer->veins;
+    if (leafer->tiling.spill) {
+        if (!read_spilled_veins(leafer, &spilled)) {
+            free(spilled.items);
+            return false;
+        }
+        veins = &spilled;
+    }
+
+    Bytes record = (Bytes){0};
+    RecordHeader header = {.magic=ARCHIVE_RECORD_MAGIC, .version=ARCHIVE_VERSION};
+    put_bytes(&record, &header, sizeof(header));
+    put_u64(&record, seed);
+    put_params(&record, &leafer->params);
+    pad_to_8(&record);
+    put_u64(&record, leafer->polygon.count);
+    put_bytes(&record, leafer->polygon.items, sizeof(Vector2) * leafer->polygon.count);
+    pad_to_8(&record);
+    put_u64(&record, triangles->count);
+    put_bytes(&record, triangles->items, sizeof(LeaferTriangle) * triangles->count);
+    pad_to_8(&record);
+    size_t veins_at = record.count;
+    put_u64(&record, 0);
+    if (!encode_compact_veins(veins, &record)) {
+        printf("Can't append a leaf to the archive\n");
+        free(record.items);
+        free(spilled.items);
+        return false;
+    }
+    uint64_t veins_size = record.count - veins_at - sizeof(uint64_t);
+    memcpy(record.items + veins_at, &veins_size, sizeof(veins_size));
+    pad_to_8(&record);
+    header.size = record.count - sizeof(header);
+    memcpy(record.items, &header, sizeof(header));
+    free(spilled.items);
+
+    pthread_mutex_lock(&archive->lock);
+    bool ok = pwrite(archive->fd, record.items, record.count, archive->end) == (ssize_t)record.count;
+    if (ok) {
+        DA_APPEND(&archive->offsets, archive->end);
+        archive->end += record.count;
+    } else {
+        // A torn record would hide the ones appended after it
+        if (ftruncate(archive->fd, archive->end) != 0) {}
+    }
+    pthread_mutex_unlock(&archive->lock);
+    free(record.items);
+    if (!ok) printf("Can't append a leaf to the archive\n");
+    return ok;
+}
+
+LeaferArchive *leafer_archive_map(const char *file_name) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        printf("Can't open file: %s\n", file_name);
+        return NULL;
+    }
+    // Writers cut the index off while they append, so the mapping keeps them out for as long as it lives
+    if (flock(fd, LOCK_SH) != 0) {
+        printf("Can't lock file: %s\n", file_name);
+        close(fd);
+        return NULL;
+    }
+    LeaferArchive *archive = calloc(1, sizeof(*archive));
+    assert(archive && "leafer_archive_map: calloc failed");
+    archive->fd = fd;
+
+    struct stat st;
+    size_t magic_size = strlen(ARCHIVE_MAGIC);
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= magic_size;
+    if (ok) {
+        archive->map_size = st.st_size;
+        void *map = mmap(NULL, archive->map_size, PROT_READ, MAP_SHARED, fd, 0);
+        ok = map != MAP_FAILED;
+        archive->map = ok ? map : NULL;
+    }
+    ok = ok && memcmp(archive->map, ARCHIVE_MAGIC, magic_size) == 0;
+    ArchiveFooter footer;
+    if (ok && read_footer(archive->map, archive->map_size, &footer)) {
+        archive->index = (const uint64_t *)(archive->map + footer.index_offset);
+        archive->count = footer.count;
+    } else if (ok) {
+        walk_records(archive->map, magic_size, archive->map_size, &archive->offsets);
+        archive->index = archive->offsets.items;
+        archive->count = archive->offsets.count;
+    }
+    if (!ok) {
+        printf("Can't read archive: %s\n", file_name);
+        archive_discard(archive);
+        return NULL;
+    }
+    printf("Archive read from file: %s, %zu leaves\n", file_name, archive->count);
+    return archive;
+}
+
+bool leafer_archive_close(LeaferArchive *archive) {
+    if (!archive) return true;
+    bool ok = true;
+    if (archive->writing) {
+        ArchiveFooter footer = {.count=archive->offsets.count, .index_offset=archive->end, .magic=ARCHIVE_INDEX_MAGIC};
+        size_t index_size = sizeof(uint64_t) * archive->offsets.count;
+        ok = pwrite(archive->fd, archive->offsets.items, index_size, archive->end) == (ssize_t)index_size &&
+             pwrite(archive->fd, &footer, sizeof(footer), archive->end + index_size) == (ssize_t)sizeof(footer);
+        if (!ok) printf("Can't write the archive index\n");
+        pthread_mutex_destroy(&archive->lock);
+    }
+    if (archive->map) munmap((void *)archive->map, archive->map_size);
+    if (close(archive->fd) != 0) ok = false;
+    free(archive->offsets.items);
+    free(archive);
+    return ok;
+}
+
+size_t leafer_archive_count(const LeaferArchive *archive) {
+    return archive->count;
+}
+
+// Takes `size` bytes of the payload, false if they run past its end
+static inline bool take(const uint8_t **p, const uint8_t *end, size_t size, const uint8_t **out) {
+    if (size > (size_t)(end - *p)) return false;
+    *out = *p;
+    *p += (size + 7) & ~(size_t)7;
+    if (*p > end) *p = end;
+    return true;
+}
+
+bool leafer_archive_entry(const LeaferArchive *archive, size_t index, LeaferEntry *entry) {
+    assert(archive->map && "leafer_archive_entry: archive is open for appending");
+    if (index >= archive->count) return false;
+    uint64_t offset = archive->index[index];
+    if (offset % 8 || offset > archive->map_size || archive->map_size - offset < sizeof(RecordHeader)) return false;
+    RecordHeader header;
+    memcpy(&header, archive->map + offset, sizeof(header));
+    if (memcmp(header.magic, ARCHIVE_RECORD_MAGIC, 4) != 0 || header.size > archive->map_size - offset - sizeof(header)) return false;
+    if (header.version != ARCHIVE_VERSION) {
+        printf("Can't read leaf %zu of archive version %u\n", index, header.version);
+        return false;
+    }
+
+    const uint8_t *p = archive->map + offset + sizeof(header), *end = p + header.size, *field;
+    uint64_t count;
+    if (!take(&p, end, sizeof(uint64_t), &field)) return false;
+    memcpy(&entry->seed, field, sizeof(entry->seed));
+    if (!take(&p, end, ARCHIVE_PARAMS_SIZE, &field)) return false;
+    get_params(field, &entry->params);
+
+    if (!take(&p, end, sizeof(uint64_t), &field)) return false;
+    memcpy(&count, field, sizeof(count));
+    if (count > header.size / sizeof(Vector2) || !take(&p, end, count * sizeof(Vector2), &field)) return false;
+    entry->outline = (const Vector2 *)field;
+    entry->outline_count = count;
+
+    if (!take(&p, end, sizeof(uint64_t), &field)) return false;
+    memcpy(&count, field, sizeof(count));
+    if (count > header.size / sizeof(LeaferTriangle) || !take(&p, end, count * sizeof(LeaferTriangle), &field)) return false;
+    entry->triangles = (const LeaferTriangle *)field;
+    entry->triangle_count = count;
+
+    if (!take(&p, end, sizeof(uint64_t), &field)) return false;
+    memcpy(&count, field, sizeof(count));
+    if (!take(&p, end, count, &field)) return false;
+    entry->veins = field;
+    entry->veins_size = count;
+    return true;
+}
+
+Leafer *leafer_archive_load(const LeaferArchive *archive, size_t index) {
+    LeaferEntry entry;
+    if (!leafer_archive_entry(archive, index, &entry) || entry.outline_count < 3) {
+        printf("Can't read leaf %zu from the archive\n", index);
+        return NULL;
+    }
+    Leafer *leafer = leafer_create(&entry.params, (Vector2){0, 0}, entry.seed);
+    Polygon2 outline = (Polygon2){0};
+    for (size_t i = 0; i < entry.outline_count; i++) DA_APPEND(&outline, entry.outline[i]);
+    replace_outline(leafer, outline);
+    if (!decode_compact_veins(&leafer->veins, entry.veins, entry.veins_size)) {
+        printf("Can't read veins of leaf %zu from the archive\n", index);
+        leafer_destroy(leafer);
+        return NULL;
+    }
+    return leafer;
+}
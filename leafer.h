@@ -0,0 +1,198 @@
+#ifndef LEAFER_H
+#define LEAFER_H
+
+// Leaf venation grown by space colonization. Every simulation lives in its own `Leafer` context,
+// there is no global state: any number of them can grow side by side, each on one thread at a time.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Same types as raylib has, include raylib.h first to share them
+#if !defined(RL_VECTOR2_TYPE)
+typedef struct Vector2 {
+    float x;
+    float y;
+} Vector2;
+#define RL_VECTOR2_TYPE
+#endif
+
+#if !defined(RL_COLOR_TYPE)
+typedef struct Color {
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+    unsigned char a;
+} Color;
+#define RL_COLOR_TYPE
+#endif
+
+#define LEAFER_COLOR_VEIN1   ((Color){175, 189, 34, 170})
+#define LEAFER_COLOR_VEIN2   ((Color){109, 179, 63, 140})
+#define LEAFER_COLOR_OUTLINE ((Color){0,   228, 48, 255})
+#define LEAFER_COLOR_FILL    ((Color){0,   97,  14, 180})
+
+// Growth parameters that can vary between simulations
+typedef struct LeaferParams {
+    float vein_radius;
+    float vein_radius_min;
+    float toleration_ratio;
+    float auxin_radius;
+    size_t auxin_spray_threshold;
+    size_t converge_steps;
+    float growth_rate;  // 0 keeps the blade static
+    float growth_start;
+    float tile_size;
+    float simplify_veins;
+    float simplify_outline;
+} LeaferParams;
+
+typedef enum LeaferStop {
+    LEAFER_STOP_NONE,
+    LEAFER_STOP_SATURATED, // new auxins only land where veins already are or where none can see them
+    LEAFER_STOP_STUCK,     // live auxins fill the threshold and no node can grow towards them
+    LEAFER_STOP_TILES,     // every tile of the out of core growth is finalised
+} LeaferStop;
+
+// Progress of a long job, another thread may read it while the job runs
+typedef struct LeaferProgress {
+    atomic_size_t done;
+    atomic_size_t total;
+} LeaferProgress;
+
+typedef struct LeaferNode {
+    Vector2 center;
+    float radius;
+    Vector2 parent; // center of the parent, (-1, -1) for the root
+} LeaferNode;
+
+typedef struct LeaferAuxin {
+    Vector2 center;
+    float radius;
+} LeaferAuxin;
+
+typedef struct LeaferTriangle {
+    Vector2 a, b, c;
+} LeaferTriangle;
+
+typedef struct LeaferTriangles {
+    LeaferTriangle *items;
+    size_t count;
+    size_t capacity;
+} LeaferTriangles;
+
+// Path from a tip of the veins to the root
+typedef struct LeaferBranch {
+    Vector2 *items;
+    size_t count;
+    size_t capacity;
+    float *widths; // vein thickness at every point
+} LeaferBranch;
+
+typedef struct LeaferTree {
+    LeaferBranch *items;
+    size_t count;
+    size_t capacity;
+} LeaferTree;
+
+typedef struct Leafer Leafer;
+
+LeaferParams leafer_default_params(void);
+// Sets parameter `name` from its text, false for an unknown name or a malformed value
+bool leafer_parse_param(LeaferParams *params, const char *name, const char *value);
+
+// Growth starts from two nodes around `seed`, the outline starts right under it
+Leafer *leafer_create(const LeaferParams *params, Vector2 seed, uint64_t random_seed);
+void leafer_destroy(Leafer *leafer);
+// Threads spraying auxins, a seed gives the same leaf on any number of them
+void leafer_set_threads(Leafer *leafer, size_t threads);
+
+// Outline is drawn point by point before the growth starts. New edges may not cross the outline
+// or come close to the seed, closing edge included.
+bool leafer_outline_accepts(const Leafer *leafer, Vector2 point);
+bool leafer_outline_add(Leafer *leafer, Vector2 point);
+void leafer_outline_undo(Leafer *leafer);
+bool leafer_outline_closes(const Leafer *leafer);
+// Outline saved with `leafer_write_outline`, the seed moves along to stay right above its first point
+bool leafer_read_outline(Leafer *leafer, const char *file_name);
+bool leafer_write_outline(const Leafer *leafer, const char *file_name);
+// Blade as it is now, it expands during marginal growth
+const Vector2 *leafer_outline(const Leafer *leafer, size_t *count);
+
+// Grayscale map of auxin density, row by row from the top, stretched over the bounding box of the blade.
+// Cells get auxins in proportion to their value, black ones none. Only before `leafer_start`.
+bool leafer_set_density(Leafer *leafer, const uint8_t *values, int width, int height);
+
+// Closes the outline and prepares the growth. With `spill_file` the leaf grows out of core.
+bool leafer_start(Leafer *leafer, const char *spill_file);
+// Grows until the growth stops or the monotonic clock passes `deadline` seconds, true once it has stopped.
+// Steps can be left half done, the next call picks them up.
+bool leafer_advance(Leafer *leafer, double deadline);
+// Grows one whole step, for when every step has to be seen. True once the growth has stopped.
+bool leafer_step(Leafer *leafer);
+double leafer_now(void);
+LeaferStop leafer_stop(const Leafer *leafer);
+// Prints why the growth stopped and how much of the blade is covered
+void leafer_report(const Leafer *leafer, const char *label);
+
+// Veins of a stored leaf in either form replace the first nodes, so it can be traced and exported
+// without growing it again. Only before `leafer_start`.
+bool leafer_read_veins(Leafer *leafer, const char *file_name);
+
+// Nodes still in memory, spilled ones are only in the files
+size_t leafer_node_count(const Leafer *leafer);
+LeaferNode leafer_node(const Leafer *leafer, size_t index);
+// Auxins keep their slots during a step, false for an empty slot
+size_t leafer_auxin_slots(const Leafer *leafer);
+bool leafer_auxin(const Leafer *leafer, size_t slot, LeaferAuxin *auxin);
+
+// Finishing the leaf. Triangulation and tracing of the same leaf may run on two threads at once,
+// nothing may grow meanwhile. `progress` may be NULL. Triangulation fails on an outline that touches itself.
+bool leafer_triangulate(Leafer *leafer, LeaferTriangles *triangles, LeaferProgress *progress);
+bool leafer_trace(const Leafer *leafer, LeaferTree *tree, LeaferTree *smooth_tree, LeaferProgress *progress);
+void leafer_free_triangles(LeaferTriangles *triangles);
+void leafer_free_tree(LeaferTree *tree);
+// Color of a vein of given thickness
+Color leafer_vein_color(float width);
+
+bool leafer_write_veins(const Leafer *leafer, const char *file_name);
+// Archival form of the veins, about an eighth of the size: positions and radii rounded to 1/64
+// and stored as varint deltas from the parent node, node order follows the tree
+bool leafer_write_veins_compact(const Leafer *leafer, const char *file_name);
+bool leafer_write_triangles(const LeaferTriangles *triangles, const char *file_name);
+bool leafer_write_svg(const Leafer *leafer, const LeaferTree *tree, const char *file_name);
+bool leafer_write_glb(const Leafer *leafer, const LeaferTriangles *triangles, const LeaferTree *tree, const char *file_name);
+// Rendered on CPU, `width` in pixels
+bool leafer_write_png(const Leafer *leafer, const LeaferTriangles *triangles, const LeaferTree *tree, int width,
+                      size_t threads, const char *file_name);
+
+// Archive of many leaves in one append-only file, indexed at its end
+typedef struct LeaferArchive LeaferArchive;
+
+// Stored leaf, pointers lead right into the mapped archive and stay valid until it is closed
+typedef struct LeaferEntry {
+    uint64_t seed;
+    LeaferParams params;
+    const Vector2 *outline;
+    size_t outline_count;
+    const LeaferTriangle *triangles;
+    size_t triangle_count;
+    const uint8_t *veins; // compact form
+    size_t veins_size;
+} LeaferEntry;
+
+// For appending, other processes opening or mapping the same archive wait until it is closed.
+// Appends may come from several threads at once.
+LeaferArchive *leafer_archive_open(const char *file_name);
+bool leafer_archive_append(LeaferArchive *archive, const Leafer *leafer, uint64_t seed, const LeaferTriangles *triangles);
+// Memory-mapped for reading, writers wait until it is closed
+LeaferArchive *leafer_archive_map(const char *file_name);
+// Appending archives get their index written here
+bool leafer_archive_close(LeaferArchive *archive);
+size_t leafer_archive_count(const LeaferArchive *archive);
+bool leafer_archive_entry(const LeaferArchive *archive, size_t index, LeaferEntry *entry);
+// Stored leaf with its outline and veins, ready to be traced and exported
+Leafer *leafer_archive_load(const LeaferArchive *archive, size_t index);
+
+#endif // LEAFER_H
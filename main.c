@@ -1,46 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
-#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include "raylib.h"
+#include "leafer.h"
 
 #define WIDTH  800
 #define HEIGHT 600
 
-#define FINAL_ATTEMPS 1000
-
 #define BLINK_DURATION 0.4f
 
 #define FONT_SIZE 25
 
 #define CELL_SIZE 15.0f
-#define MIN_POLYGON_DIST 10.0f
-#define MIN_POLYGON_LEN 3.0f
-#define SMOOTH_RATIO 0.80f
-#define SMOOTH_ITERATION 100
-
-#define VEIN_RADIUS 10.0f
-#define VEIN_RADIUS_MIN 3.0f
 #define VEIN_CENTER 2.0f
-#define TOLERATION_RATIO 0.9f
-// Generation ratio is used to calculate the reduction in node radius
-// hense starting with some relatively big number
-#define GEN_START 50
-
-#define AUXIN_RADIUS 10.0f
 #define AUXIN_DOT_RADIUS 2.0f
-#define AUXIN_SPRAY_THRESHOLD 100
-
-#define LEAF_VEIN_THCK_START 1.0f
-#define LEAF_VEIN_THCK_END   6.0f
-#define LEAF_COLOR_VEIN1     (Color){175, 189, 34, 170}
-#define LEAF_COLOR_VEIN2     (Color){109, 179, 63, 140}
-#define LEAF_COLOR_OUTLINE   GREEN
-#define LEAF_COLOR_FILL      (Color){0,   97,  14, 180}
+#define FRAME_BUDGET_MS 12.0  // growth time per frame of the interactive window
+#define CAPTURE_FPS 30        // frame rate written into captured Y4M streams
 
 #define DA_APPEND(da, item)                                                    \
     do {                                                                       \
@@ -53,862 +38,874 @@
         (da)->items[(da)->count++] = (item);                                   \
     } while (0)
 
-
-
-const char *hint1 = "Left click to commit leaf's edge";
-int hint1_x;
-int hint1_y;
-
-const char *hint2 = "Right click to cancel last commited edge";
-int hint2_x;
-int hint2_y;
-
-const char *hint3 = "Space to attempt to close the loop";
-int hint3_x;
-int hint3_y;
-
-const char *hint4 = "Cannot finish the loop";
-int hint4_x;
-int hint4_y;
-
-
-typedef struct Polygon2 {
-    Vector2 *items;
-    size_t count;
-    size_t capacity;
-    bool closed;
-} Polygon2;
-
 typedef enum Stage {
     DRAWING,
     GROWING,
+    FINISHING,
     STOPPED,
 } Stage;
 
-typedef struct Indeces {
-    size_t *items;
-    size_t count;
-    size_t capacity;
-} Indeces;
-
-typedef struct Node {
-    Vector2 center;
-    float radius;
-    Indeces closest_source_indeces;
-    Vector2 parent;
-    size_t gen;
-} Node;
-
-typedef struct Veins {
-    Node *items;
-    size_t count;
-    size_t capacity;
-} Veins;
+typedef struct Hint {
+    const char *text;
+    int x;
+    int y;
+} Hint;
+
+// Everything the drawing stage keeps between frames
+typedef struct Drawing {
+    Hint commit;
+    Hint cancel;
+    Hint close;
+    Hint failed;
+    double dt;
+    bool blink_happening;
+} Drawing;
+
+static Drawing drawing_init(int width, int height) {
+    Drawing drawing = {
+        .commit={"Left click to commit leaf's edge"},
+        .cancel={"Right click to cancel last commited edge"},
+        .close={"Space to attempt to close the loop"},
+        .failed={"Cannot finish the loop"},
+    };
+    drawing.commit.x = (width - strlen(drawing.commit.text) * FONT_SIZE / 2) / 2;
+    drawing.commit.y = height / 3 - FONT_SIZE;
+    drawing.cancel.x = (width - strlen(drawing.cancel.text) * FONT_SIZE / 2) / 2;
+    drawing.cancel.y = height / 3;
+    drawing.close.x = (width - strlen(drawing.close.text) * FONT_SIZE / 2) / 2;
+    drawing.close.y = height / 3 + FONT_SIZE;
+    drawing.failed.x = (width - strlen(drawing.failed.text) * FONT_SIZE) / 2;
+    drawing.failed.y = height / 3 + 4 * FONT_SIZE;
+    return drawing;
+}
 
-typedef struct Branch {
-    Vector2 *items;
-    size_t count;
-    size_t capacity;
-} Branch;
+// true if finished
+static bool drawing(Drawing *state, Leafer *leafer, Vector2 seed_coord, float first_node_radius, int width, int height) {
+    // draw cells for easier drawing
+    for (int x = CELL_SIZE; x < width; x += CELL_SIZE)
+        DrawLine(x, 0, x, height, (Color){ 130, 130, 130, 155 });
+    for (int y = CELL_SIZE; y < height; y += CELL_SIZE)
+        DrawLine(0, y, width, y, (Color){ 130, 130, 130, 155 }); // 200, 200, 200, 255
 
-typedef struct Tree {
-    Branch *items;
-    size_t count;
-    size_t capacity;
-} Tree;
+    state->dt += GetFrameTime();
+    Vector2 mouse = GetMousePosition();
 
-typedef struct Source {
-    Vector2 center;
-    float radius;
-    size_t closest_node_index;
-} Source;
+    if (IsKeyPressed(KEY_SPACE)) {
+        // Closing edge may not cross the outline or the first nodes either
+        if (leafer_outline_closes(leafer)) return true; // drawing finished
+        // else
+        state->dt = 0;
+        state->blink_happening = true;
+    }
 
-typedef struct Auxins {
-    Source *items;
-    size_t count;
-    size_t capacity;
-} Auxins;
+    Color bg_color = LIGHTGRAY;
+    if (state->dt >= BLINK_DURATION) state->blink_happening = false;
+    if (state->blink_happening) {
+        bg_color = (Color){ 230, 41, 55, 100 };
+        DrawText(state->failed.text, state->failed.x, state->failed.y, 2 * FONT_SIZE, (Color){ 120, 120, 120, 255 });
+    }
+    ClearBackground(bg_color);
 
-typedef struct Edge2 {
-    Vector2 a, b;
-} Edge2;
+    DrawText(state->commit.text, state->commit.x, state->commit.y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
+    DrawText(state->cancel.text, state->cancel.x, state->cancel.y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
+    DrawText(state->close.text, state->close.x, state->close.y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
 
-typedef struct Triangle2 {
-    Vector2 a, b, c;
-} Triangle2;
+    DrawCircle(seed_coord.x, seed_coord.y, first_node_radius, WHITE);
+    DrawCircle(seed_coord.x, seed_coord.y, VEIN_CENTER, BLACK);
 
-typedef struct Vertices {
-    Triangle2 *items;
     size_t count;
-    size_t capacity;
-} Vertices;
+    const Vector2 *outline = leafer_outline(leafer, &count);
+    for (size_t i = 0; i + 1 < count; i++) {
+        DrawLineEx(outline[i], outline[i + 1], 2.0f, GREEN);
+    }
 
+    // Last commited point
+    Vector2 p = outline[count - 1];
+    bool polygon_valid = leafer_outline_accepts(leafer, mouse);
+    Color color = polygon_valid ? GREEN : RED;
+    DrawLineEx(p, mouse, 2.0f, color);
 
-static bool write_polygon_file(const Polygon2 *polygon, const char *file_name) {
-    FILE *file_desc = fopen(file_name, "wb");
-    if (!file_desc) {
-        printf("Can't open file: %s\n", file_name);
-        return false;
-    }
-    if (fwrite(&polygon->count, sizeof(polygon->count), 1, file_desc) != 1) {
-        printf("Can't write amount of polygon points to file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
-    }
-    if (fwrite(polygon->items, sizeof(Vector2), polygon->count, file_desc) != polygon->count) {
-        printf("Can't write a polygon points to file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
+        // Commit new point if new edge does not intersect anything
+        leafer_outline_add(leafer, mouse);
     }
-    if (fclose(file_desc) != 0) {
-        printf("Can't close file: %s\n", file_name);
-        return false;
+
+    if (IsMouseButtonPressed(MOUSE_RIGHT_BUTTON)) {
+        leafer_outline_undo(leafer);
     }
-    printf("Polygon saved to file: %s\n", file_name);
-    return true;
+    return false;
 }
 
-static bool read_polygon_file(Polygon2 *polygon, const char *file_name) {
-    FILE *file_desc = fopen(file_name, "rb");
+typedef struct Job {
+    char *outline_file;
+    uint64_t seed;
+    LeaferParams params;
+} Job;
+
+typedef struct Jobs {
+    Job *items;
+    size_t count;
+    size_t capacity;
+} Jobs;
+
+// Only shared piece of the batch is the counter of the next job to pick
+typedef struct Batch {
+    const Jobs *jobs;
+    const char *out_dir;
+    bool svg;
+    bool glb;
+    bool spill;    // grow out of core
+    bool compact;  // veins in the archival form
+    LeaferArchive *archive; // leaves go here instead of their own veins and vertices files
+    const Image *density;   // grayscale auxin density of every leaf, NULL for uniform
+    int png_width; // 0 for no PNG
+    size_t job_threads; // each job may spray and render on this many threads
+    atomic_size_t next_job;
+    atomic_size_t failed;
+} Batch;
+
+static bool read_manifest(Jobs *jobs, const char *file_name) {
+    FILE *file_desc = fopen(file_name, "r");
     if (!file_desc) {
         printf("Can't open file: %s\n", file_name);
         return false;
     }
-    if (fread(&polygon->count, sizeof(polygon->count), 1, file_desc) != 1) {
-        printf("Can't read number of a polygon points from file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
-    }
-    polygon->capacity = polygon->count;
-    polygon->items = realloc(polygon->items, sizeof(Vector2) * polygon->capacity);
-    if (fread(polygon->items, sizeof(Vector2), polygon->count, file_desc) != polygon->count) {
-        printf("Can't read polygon points from file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
+
+    char line[4096];
+    size_t line_num = 0;
+    while (fgets(line, sizeof(line), file_desc)) {
+        line_num++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char *save = NULL;
+        const char *outline_file = strtok_r(line, " \t\r\n", &save);
+        if (!outline_file) continue; // empty line
+        const char *seed_str = strtok_r(NULL, " \t\r\n", &save);
+        char *end = NULL;
+        uint64_t seed = seed_str ? strtoull(seed_str, &end, 10) : 0;
+        if (!seed_str || end == seed_str || *end != '\0') {
+            printf("%s:%zu: Expected a numeric seed after the outline file\n", file_name, line_num);
+            fclose(file_desc);
+            return false;
+        }
+
+        Job job = {.outline_file=NULL, .seed=seed, .params=leafer_default_params()};
+        for (char *param = strtok_r(NULL, " \t\r\n", &save); param; param = strtok_r(NULL, " \t\r\n", &save)) {
+            char *eq = strchr(param, '=');
+            if (eq) *eq = '\0';
+            if (!eq || !leafer_parse_param(&job.params, param, eq + 1)) {
+                printf("%s:%zu: Invalid parameter: %s\n", file_name, line_num, param);
+                fclose(file_desc);
+                return false;
+            }
+        }
+        job.outline_file = strdup(outline_file);
+        DA_APPEND(jobs, job);
     }
+
     if (fclose(file_desc) != 0) {
         printf("Can't close file: %s\n", file_name);
         return false;
     }
-    printf("Polygon read from file: %s\n", file_name);
     return true;
 }
 
-static bool read_veins_file(Veins *veins, const char *file_name) {
-    FILE *file_desc = fopen(file_name, "rb");
-    if (!file_desc) {
-        printf("Can't open file: %s\n", file_name);
-        return false;
-    }
-    if (fread(&veins->count, sizeof(veins->count), 1, file_desc) != 1) {
-        printf("Can't read number of a veins nodes from file: %s\n", file_name);
-        fclose(file_desc);
+// Grow a single leaf from start to finish without any window, results go to `out_dir`
+static bool grow_job(const Batch *batch, size_t index) {
+    const Job *job = &batch->jobs->items[index];
+    const char *out_dir = batch->out_dir;
+    // Seed follows the outline, see `leafer_read_outline`
+    Leafer *leafer = leafer_create(&job->params, (Vector2){0, 0}, job->seed);
+    if (!leafer_read_outline(leafer, job->outline_file)) {
+        printf("Job %zu: no valid outline in %s\n", index, job->outline_file);
+        leafer_destroy(leafer);
         return false;
     }
-    veins->capacity = veins->count;
-    veins->items = realloc(veins->items, sizeof(Node) * veins->capacity);
-    if (fread(veins->items, sizeof(Node), veins->count, file_desc) != veins->count) {
-        printf("Can't read veins nodes from file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
-    }
-    if (fclose(file_desc) != 0) {
-        printf("Can't close file: %s\n", file_name);
+    leafer_set_threads(leafer, batch->job_threads);
+    if (batch->density && !leafer_set_density(leafer, batch->density->data, batch->density->width, batch->density->height)) {
+        leafer_destroy(leafer);
         return false;
     }
-    printf("Veins read from file: %s\n", file_name);
-    return true;
-}
 
-static bool write_veins_file(const Veins *veins, const char *file_name) {
-    FILE *file_desc = fopen(file_name, "wb");
-    if (!file_desc) {
-        printf("Can't open file: %s\n", file_name);
+    char spill_file[4096];
+    snprintf(spill_file, sizeof(spill_file), "%s/leaf_%05zu_spill.bin", out_dir, index);
+    if (!leafer_start(leafer, batch->spill ? spill_file : NULL)) {
+        leafer_destroy(leafer);
         return false;
     }
-    if (fwrite(&veins->count, sizeof(veins->count), 1, file_desc) != 1) {
-        printf("Can't write amount of veins nodes to file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
-    }
-    if (fwrite(veins->items, sizeof(Node), veins->count, file_desc) != veins->count) {
-        printf("Can't write a veins nodes to file: %s\n", file_name);
-        fclose(file_desc);
-        return false;
+
+    leafer_advance(leafer, INFINITY);
+    char label[32];
+    snprintf(label, sizeof(label), "Job %zu", index);
+    leafer_report(leafer, label);
+
+    char file_name[4096];
+    bool ok;
+    if (batch->archive) {
+        ok = true;
+    } else if (batch->compact) {
+        snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu_veins.lvq", out_dir, index);
+        ok = leafer_write_veins_compact(leafer, file_name);
+    } else {
+        snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu_veins.bin", out_dir, index);
+        ok = leafer_write_veins(leafer, file_name);
+    }
+
+    LeaferTriangles triangles = (LeaferTriangles){0};
+    if (ok) {
+        ok = leafer_triangulate(leafer, &triangles, NULL);
+        if (!ok) {
+            printf("Can't triangulate leaf %zu\n", index);
+        } else if (batch->archive) {
+            ok = leafer_archive_append(batch->archive, leafer, job->seed, &triangles);
+        } else {
+            snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu_vertices.bin", out_dir, index);
+            ok = leafer_write_triangles(&triangles, file_name);
+        }
     }
-    if (fclose(file_desc) != 0) {
-        printf("Can't close file: %s\n", file_name);
-        return false;
+
+    LeaferTree tree = (LeaferTree){0};
+    LeaferTree smooth_tree = (LeaferTree){0};
+    bool exports = batch->svg || batch->glb || batch->png_width > 0;
+    if (ok && exports) ok = leafer_trace(leafer, &tree, &smooth_tree, NULL);
+
+    if (ok && batch->svg) {
+        snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu.svg", out_dir, index);
+        ok = leafer_write_svg(leafer, &smooth_tree, file_name);
     }
-    printf("Veins saved to file: %s\n", file_name);
-    return true;
-}
 
+    if (ok && batch->glb) {
+        snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu.glb", out_dir, index);
+        ok = leafer_write_glb(leafer, &triangles, &smooth_tree, file_name);
+    }
 
-static inline bool same_v2(Vector2 a, Vector2 b) { return a.x == b.x && a.y == b.y; }
+    if (ok && batch->png_width > 0) {
+        snprintf(file_name, sizeof(file_name), "%s/leaf_%05zu.png", out_dir, index);
+        ok = leafer_write_png(leafer, &triangles, &smooth_tree, batch->png_width, batch->job_threads, file_name);
+    }
 
-static inline Vector2 sub_v2(Vector2 a, Vector2 b) {
-    return (Vector2){a.x - b.x, a.y - b.y};
+    leafer_free_triangles(&triangles);
+    leafer_free_tree(&tree);
+    leafer_free_tree(&smooth_tree);
+    leafer_destroy(leafer);
+    if (batch->spill) remove(spill_file);
+    return ok;
 }
 
-static inline Vector2 add_v2(Vector2 a, Vector2 b) {
-    return (Vector2){a.x + b.x, a.y + b.y};
+static void *batch_worker(void *arg) {
+    Batch *batch = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&batch->next_job, 1);
+        if (i >= batch->jobs->count) break;
+        if (!grow_job(batch, i)) atomic_fetch_add(&batch->failed, 1);
+    }
+    return NULL;
 }
 
-static inline Vector2 scale_v2(Vector2 a, float s) {
-    return (Vector2){a.x * s, a.y * s};
-}
+// `batch` comes with the output options set, jobs are taken from the manifest
+static int run_batch(const char *manifest, Batch *batch, size_t threads_count, const char *archive_file) {
+    Jobs jobs = (Jobs){0};
+    if (!read_manifest(&jobs, manifest)) return 1;
+    if (archive_file) {
+        batch->archive = leafer_archive_open(archive_file);
+        if (!batch->archive) return 1;
+    }
 
-static inline float len_v2_sq(Vector2 ab) {
-    return ab.x * ab.x + ab.y * ab.y;
-}
+    if (threads_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads_count = cores > 0 ? (size_t)cores : 1;
+    }
+    // Spare threads go to the rasteriser when there are fewer leaves than threads
+    batch->job_threads = jobs.count > 0 && threads_count > jobs.count ? threads_count / jobs.count : 1;
+    if (threads_count > jobs.count) threads_count = jobs.count;
+    printf("Growing %zu leaves on %zu threads\n", jobs.count, threads_count);
 
-static inline float len_v2(Vector2 ab) {
-    return sqrt(len_v2_sq(ab));
-}
+    batch->jobs = &jobs;
+    atomic_init(&batch->next_job, 0);
+    atomic_init(&batch->failed, 0);
 
-static inline float cross_v2(Vector2 ab, Vector2 ap) {
-    return ab.x * ap.y - ab.y * ap.x;
-}
+    pthread_t *threads = malloc(sizeof(*threads) * threads_count);
+    size_t started = 0;
+    for (; started < threads_count; started++) {
+        if (pthread_create(&threads[started], NULL, batch_worker, batch) != 0) break;
+    }
+    // Could not get a single thread, do the work right here
+    if (started == 0) batch_worker(batch);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
 
-static inline Color lerp_color(Color a, Color b, float p) {
-    return (Color) {
-        (unsigned char)(a.r + (b.r - a.r)*p),
-        (unsigned char)(a.g + (b.g - a.g)*p),
-        (unsigned char)(a.b + (b.b - a.b)*p),
-        (unsigned char)(a.a + (b.a - a.a)*p),
-    };
-}
+    size_t failed = atomic_load(&batch->failed);
+    printf("Finished %zu leaves, %zu failed\n", jobs.count - failed, failed);
+    if (!leafer_archive_close(batch->archive)) failed++;
 
-static Vector2 norm_v2(Vector2 v) {
-    // Calculating on double precision to check for overflow
-    double len = sqrt(v.x * v.x + v.y * v.y);
-    if (fabs(len) > (double)__FLT_MAX__) return (Vector2){0, 0};
-    float inv = 1.0f / len;
-    return (Vector2){v.x * inv, v.y * inv};
+    for (size_t i = 0; i < jobs.count; i++) {
+        free(jobs.items[i].outline_file);
+    }
+    free(jobs.items);
+    return failed > 0 ? 1 : 0;
 }
 
-// Closest point on a line defined by segment AB to point C, if clampled - strictly on segment
-static Vector2 closest_on_segment(Vector2 a, Vector2 b, Vector2 c, bool clamped) {
-    Vector2 ab = sub_v2(b, a);
-    Vector2 ac = sub_v2(c, a);
-    float t = (ac.x * ab.x + ac.y * ab.y) / len_v2_sq(ab);
-    // clamp
-    if (clamped) t = t < 0 ? 0.0f : (t > 1 ? 1 : t);
-    return (Vector2){a.x + t * ab.x, a.y + t * ab.y};
+// Work left after the growth in the window. Triangulation and vein tracing run on their own threads,
+// the mesh export starts once both are done. Frames keep coming meanwhile.
+typedef struct Finishing {
+    Leafer *leafer; // only its scratch memory is written, by the triangulation
+    const char *archive_file; // NULL when the leaf isn't archived
+    uint64_t seed;
+    LeaferTriangles triangles;
+    LeaferTree tree;
+    LeaferTree smooth_tree;
+    LeaferProgress triangulation;
+    LeaferProgress tracing;
+    atomic_bool triangulated;
+    atomic_bool traced;
+    atomic_bool exported;
+    pthread_t threads[3]; // triangulation, tracing, export
+    bool started[3];      // false when the job has run on the main thread instead
+    bool exporting;
+} Finishing;
+
+static void *triangulate_job(void *arg) {
+    Finishing *finishing = arg;
+    if (!leafer_triangulate(finishing->leafer, &finishing->triangles, &finishing->triangulation)) {
+        printf("Can't triangulate the leaf\n");
+    }
+    atomic_store(&finishing->triangulated, true);
+    return NULL;
 }
 
-// Distance from C to a line defined by segment AB, if clampled - strictly to segment
-static float distance_v2(Vector2 a, Vector2 b, Vector2 c, bool clamped) {
-    if (same_v2(a, b)) return len_v2(sub_v2(a, c));
-    return len_v2(sub_v2(c, closest_on_segment(a, b, c, clamped)));
+static void *trace_job(void *arg) {
+    Finishing *finishing = arg;
+    const Leafer *leafer = finishing->leafer;
+    leafer_write_veins(leafer, "veins_out.bin");
+    leafer_trace(leafer, &finishing->tree, &finishing->smooth_tree, &finishing->tracing);
+    leafer_write_svg(leafer, &finishing->smooth_tree, "leaf_out.svg");
+    atomic_store(&finishing->traced, true);
+    return NULL;
 }
 
-static inline int sign(float x) { return (x > 0) - (x < 0); }
-
-static int orient(Vector2 a, Vector2 b, Vector2 c) {
-    // orientation of triplet (a,b,c): >0 left, <0 right, 0 collinear
-    return sign(cross_v2(sub_v2(b, a), sub_v2(c, a)));
+static void *export_job(void *arg) {
+    Finishing *finishing = arg;
+    leafer_write_glb(finishing->leafer, &finishing->triangles, &finishing->smooth_tree, "leaf_out.glb");
+    if (finishing->archive_file) {
+        // Opened only for this leaf, so batches can append to the same archive meanwhile
+        LeaferArchive *archive = leafer_archive_open(finishing->archive_file);
+        if (archive) {
+            leafer_archive_append(archive, finishing->leafer, finishing->seed, &finishing->triangles);
+            leafer_archive_close(archive);
+        }
+    }
+    atomic_store(&finishing->exported, true);
+    return NULL;
 }
 
-static int on_segment(Vector2 a, Vector2 b, Vector2 p) {
-    // assumes p is collinear with a-b; check bounding box
-    return (p.x >= fminf(a.x, b.x) && p.x <= fmaxf(a.x, b.x)
-         && p.y >= fminf(a.y, b.y) && p.y <= fmaxf(a.y, b.y));
+// Jobs that can't get a thread of their own run right away on the calling one
+static void finishing_run(Finishing *finishing, size_t index, void *(*job)(void *)) {
+    finishing->started[index] = pthread_create(&finishing->threads[index], NULL, job, finishing) == 0;
+    if (!finishing->started[index]) job(finishing);
 }
 
-bool segments_intersect(Vector2 a1, Vector2 a2, Vector2 b1, Vector2 b2) {
-    int o1 = orient(a1, a2, b1); // where b1 relative to A
-    int o2 = orient(a1, a2, b2); // where b2 relative to A
-    int o3 = orient(b1, b2, a1); // where a1 relative to B
-    int o4 = orient(b1, b2, a2); // where a2 relative to B
-
-    if (o1 != o2 && o3 != o4)
-        return true; // proper intersection
-
-    // special collinear cases
-    if (o1 == 0 && on_segment(a1, a2, b1)) return true;
-    if (o2 == 0 && on_segment(a1, a2, b2)) return true;
-    if (o3 == 0 && on_segment(b1, b2, a1)) return true;
-    if (o4 == 0 && on_segment(b1, b2, a2)) return true;
-
-    return false;
+static void finishing_start(Finishing *finishing, Leafer *leafer, const char *archive_file, uint64_t seed) {
+    *finishing = (Finishing){.leafer=leafer, .archive_file=archive_file, .seed=seed};
+    finishing_run(finishing, 0, triangulate_job);
+    finishing_run(finishing, 1, trace_job);
 }
 
-static bool segment_intersect_polygon(Vector2 a, Vector2 b, const Polygon2 *polygon) {
-    if (same_v2(a, b)) return false;      // zero lenght segment in
-    if (polygon->count < 2) return false; // no actual segments to test against in the list
-
-    // Skip last edge if polygon not yet closed
-    size_t max_index = polygon->closed ? polygon->count : polygon->count - 1;
-
-    for (size_t i = 0; i < max_index; i++) {
-        Vector2 c = polygon->items[i];
-        Vector2 d = polygon->items[(i + 1) % polygon->count];
-        assert(!same_v2(c, d) && "Leaf contain zero lenght segment");
-        bool a_is_c = same_v2(a, c);
-        bool a_is_d = same_v2(a, d);
-        bool b_is_c = same_v2(b, c);
-        bool b_is_d = same_v2(b, d);
-
-        // Segments fully match
-        if ((a_is_c && b_is_d) || (a_is_d && b_is_c)) continue;
-
-        // Segments are sequential
-        if (a_is_c || a_is_d) {
-            // Test B distance to CD
-            if (distance_v2(c, d, b, true) < MIN_POLYGON_DIST) return true;
-            continue;
+// Results are handed over once triangulation and tracing are done, true from then on
+static bool finishing_poll(Finishing *finishing) {
+    if (!atomic_load(&finishing->triangulated) || !atomic_load(&finishing->traced)) return false;
+    if (!finishing->exporting) {
+        for (size_t i = 0; i < 2; i++) {
+            if (finishing->started[i]) pthread_join(finishing->threads[i], NULL);
         }
-        if (b_is_c || b_is_d) {
-            // Test A distance to CD
-            if (distance_v2(c, d, a, true) < MIN_POLYGON_DIST) return true;
-            continue;
-        }
-
-        // General case
-        if (segments_intersect(a, b, c, d)) return true;
+        finishing->exporting = true;
+        finishing_run(finishing, 2, export_job);
     }
-    return false;
+    return true;
 }
 
-// true if finished
-static bool drawing(Polygon2 *polygon, Vector2 seed_coord, int width, int height) {
-    static double dt;
-    static bool blink_happening = false;
-    static const float first_node_radius = 2 * VEIN_RADIUS;
-
-    // draw cells for easier drawing
-    for (int x = CELL_SIZE; x < width; x += CELL_SIZE)
-        DrawLine(x, 0, x, height, (Color){ 130, 130, 130, 155 });
-    for (int y = CELL_SIZE; y < height; y += CELL_SIZE)
-        DrawLine(0, y, width, y, (Color){ 130, 130, 130, 155 }); // 200, 200, 200, 255
-
-    dt += GetFrameTime();
-    bool polygon_valid;
-    Vector2 mouse = GetMousePosition();
-
-    // Last commited point
-    Vector2 p = polygon->items[polygon->count - 1];
+static void finishing_free(Finishing *finishing) {
+    if (!finishing->leafer) return;
+    // Whatever still runs needs the data
+    while (!finishing_poll(finishing)) usleep(1000);
+    if (finishing->started[2]) pthread_join(finishing->threads[2], NULL);
+    leafer_free_triangles(&finishing->triangles);
+    leafer_free_tree(&finishing->tree);
+    leafer_free_tree(&finishing->smooth_tree);
+    *finishing = (Finishing){0};
+}
 
-    if (IsKeyPressed(KEY_SPACE)) {
-        polygon_valid = polygon->count >= 3;
-        // Check if the line from the last commited point to the first intersect the vein
-        if (polygon_valid) polygon_valid = distance_v2(p, polygon->items[0], seed_coord, true) > first_node_radius;
-        // Or any previous edge
-        if (polygon_valid) polygon_valid = !segment_intersect_polygon(p, polygon->items[0], polygon);
-        if (polygon_valid) return true; // drawing finished
-        // else
-        dt = 0;
-        blink_happening = true;
+// Growth animation capture. Frames are read back into one of two slots and encoded by a background
+// thread while the next frame renders, the window only waits when the encoder falls two frames behind.
+// Frames go to a numbered PNG sequence in a directory, or as a Y4M stream to a `.y4m` file or
+// to a command when the target starts with `|`.
+typedef struct Capture {
+    const char *target;
+    FILE *stream; // Y4M output, NULL for PNG frames
+    bool piped;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Image slots[2];
+    bool full[2];
+    size_t rendered; // frames handed to the encoder
+    size_t encoded;
+    bool closing;
+    bool failed;
+} Capture;
+
+// RGBA to 4:2:0 Y'CbCr (BT.601, full range) in the layout of a Y4M frame
+static bool write_y4m_frame(FILE *stream, Image image, uint8_t *planes) {
+    int w = image.width, h = image.height;
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+    const uint8_t *rgba = image.data;
+    uint8_t *y_plane = planes, *u_plane = planes + w * h, *v_plane = u_plane + cw * ch;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const uint8_t *p = rgba + 4 * (y * w + x);
+            y_plane[y * w + x] = (uint8_t)(0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2] + 0.5f);
+        }
     }
-
-    Color bg_color = LIGHTGRAY;
-    if (dt >= BLINK_DURATION) blink_happening = false;
-    if (blink_happening) {
-        bg_color = (Color){ 230, 41, 55, 100 };
-        DrawText(hint4, hint4_x, hint4_y, 2 * FONT_SIZE, (Color){ 120, 120, 120, 255 });
+    for (int y = 0; y < ch; y++) {
+        for (int x = 0; x < cw; x++) {
+            // Average of the 2x2 block, clamped at the odd edges
+            float r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    int sx = 2 * x + dx < w ? 2 * x + dx : w - 1;
+                    int sy = 2 * y + dy < h ? 2 * y + dy : h - 1;
+                    const uint8_t *p = rgba + 4 * (sy * w + sx);
+                    r += p[0]; g += p[1]; b += p[2];
+                }
+            }
+            r /= 4; g /= 4; b /= 4;
+            u_plane[y * cw + x] = (uint8_t)(128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f);
+            v_plane[y * cw + x] = (uint8_t)(128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f);
+        }
     }
-    ClearBackground(bg_color); BLACK;
-
-    DrawText(hint1, hint1_x, hint1_y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
-    DrawText(hint2, hint2_x, hint2_y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
-    DrawText(hint3, hint3_x, hint3_y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
-
-    DrawCircle(seed_coord.x, seed_coord.y, first_node_radius, WHITE);
-    DrawCircle(seed_coord.x, seed_coord.y, VEIN_CENTER, BLACK);
+    size_t size = (size_t)w * h + 2 * (size_t)cw * ch;
+    return fputs("FRAME\n", stream) >= 0 && fwrite(planes, 1, size, stream) == size;
+}
 
-    polygon_valid = distance_v2(p, mouse, seed_coord, true) > first_node_radius;
-    if (polygon_valid) polygon_valid = !segment_intersect_polygon(p, mouse, polygon);
+static void *capture_encoder(void *arg) {
+    Capture *capture = arg;
+    uint8_t *planes = NULL;
+    int stream_width = 0, stream_height = 0;
+    for (size_t frame = 0;; frame++) {
+        size_t slot = frame % 2;
+        pthread_mutex_lock(&capture->lock);
+        while (!capture->full[slot] && !capture->closing) pthread_cond_wait(&capture->changed, &capture->lock);
+        bool full = capture->full[slot];
+        Image image = capture->slots[slot];
+        pthread_mutex_unlock(&capture->lock);
+        if (!full) break;
+
+        bool ok = true;
+        if (capture->stream) {
+            if (!planes) {
+                // Stream keeps the size of the first frame
+                stream_width = image.width;
+                stream_height = image.height;
+                planes = malloc((size_t)stream_width * stream_height * 2);
+                assert(planes && "capture_encoder: malloc failed");
+                ok = fprintf(capture->stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", stream_width, stream_height, CAPTURE_FPS) > 0;
+            }
+            ok = ok && image.width == stream_width && image.height == stream_height && write_y4m_frame(capture->stream, image, planes);
+        } else {
+            char file_name[4096];
+            snprintf(file_name, sizeof(file_name), "%s/frame_%06zu.png", capture->target, frame);
+            ok = ExportImage(image, file_name);
+        }
+        UnloadImage(image);
 
-    for (size_t i = 0; i < polygon->count - 1; i++) {
-        DrawLineEx(polygon->items[i], polygon->items[i + 1], 2.0f, GREEN);
+        pthread_mutex_lock(&capture->lock);
+        if (!ok) capture->failed = true;
+        capture->full[slot] = false;
+        capture->encoded++;
+        pthread_cond_broadcast(&capture->changed);
+        pthread_mutex_unlock(&capture->lock);
     }
+    free(planes);
+    return NULL;
+}
 
-    Color color = polygon_valid ? GREEN : RED;
-    DrawLineEx(p, mouse, 2.0f, color);
-
-    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
-        // Commit new point if new edge does not intersect anything
-        if (polygon_valid) DA_APPEND(polygon, mouse);
+static bool capture_start(Capture *capture, const char *target) {
+    *capture = (Capture){.target=target};
+    size_t len = strlen(target);
+    bool y4m_file = len > 4 && strcmp(target + len - 4, ".y4m") == 0;
+    if (target[0] == '|') {
+        capture->stream = popen(target + 1, "w");
+        capture->piped = true;
+    } else if (y4m_file) {
+        capture->stream = fopen(target, "wb");
+    } else if (mkdir(target, 0755) != 0 && errno != EEXIST) {
+        printf("Can't create capture directory: %s\n", target);
+        return false;
     }
-
-    if (IsMouseButtonPressed(MOUSE_RIGHT_BUTTON) && polygon->count > 1) {
-        polygon->count--;
+    if ((capture->piped || y4m_file) && !capture->stream) {
+        printf("Can't open capture output: %s\n", target);
+        return false;
     }
-    return false;
-}
-
-static bool point_inside(Vector2 point, const Polygon2 *polygon, float *min_dist) {
-    int winding_number = 0;
-    *min_dist = __FLT_MAX__;
-
-    for (size_t i = 0; i < polygon->count; i++) {
-        Vector2 start = polygon->items[i];
-        Vector2 end = polygon->items[(i + 1) % polygon->count];
-
-        float dist = distance_v2(start, end, point, true);
-        if (*min_dist > dist) *min_dist = dist;
-
-        Vector2 ab = sub_v2(end, start);
-        Vector2 ap = sub_v2(point, start);
-
-        if (start.y <= point.y && end.y > point.y) {
-            if (cross_v2(ab, ap) > 0) winding_number += 1;
-        } else if (start.y > point.y && end.y <= point.y) {
-            if (cross_v2(ab, ap) < 0) winding_number -= 1;
-        }
+    pthread_mutex_init(&capture->lock, NULL);
+    pthread_cond_init(&capture->changed, NULL);
+    if (pthread_create(&capture->thread, NULL, capture_encoder, capture) != 0) {
+        printf("Can't start the capture encoder\n");
+        if (capture->stream) capture->piped ? pclose(capture->stream) : fclose(capture->stream);
+        capture->stream = NULL;
+        return false;
     }
+    return true;
+}
 
-    return winding_number != 0;  // Non-zero means inside
+// Takes the frame drawn so far, call before EndDrawing
+static void capture_frame(Capture *capture) {
+    size_t slot = capture->rendered % 2;
+    pthread_mutex_lock(&capture->lock);
+    while (capture->full[slot]) pthread_cond_wait(&capture->changed, &capture->lock);
+    pthread_mutex_unlock(&capture->lock);
+
+    // Whatever is still batched has to reach the framebuffer before it's read. Ending scissor mode draws
+    // the batch out, and the scissor test it turns off was never on.
+    EndScissorMode();
+    Image image = LoadImageFromScreen();
+
+    pthread_mutex_lock(&capture->lock);
+    capture->slots[slot] = image;
+    capture->full[slot] = true;
+    capture->rendered++;
+    pthread_cond_broadcast(&capture->changed);
+    pthread_mutex_unlock(&capture->lock);
 }
 
-static void spray_auxins(Auxins *auxins, const Polygon2 *polygon, int width, int height) {
-    while (auxins->count < AUXIN_SPRAY_THRESHOLD) {
-        Vector2 p = {GetRandomValue(0, width), GetRandomValue(0, height)};
-        float min_dist;
-        if (point_inside(p, polygon, &min_dist) && min_dist > AUXIN_DOT_RADIUS) {
-            assert(min_dist < __FLT_MAX__ && "A point inside the shape should have finite minimal distance");
-            DA_APPEND(auxins, ((Source){.center=p, .radius=AUXIN_RADIUS, .closest_node_index=0}));
-        }
-    }
+// Waits for the frames still being encoded
+static bool capture_stop(Capture *capture) {
+    pthread_mutex_lock(&capture->lock);
+    capture->closing = true;
+    pthread_cond_broadcast(&capture->changed);
+    pthread_mutex_unlock(&capture->lock);
+    pthread_join(capture->thread, NULL);
+
+    bool ok = !capture->failed;
+    if (capture->stream) {
+        int closed = capture->piped ? pclose(capture->stream) : fclose(capture->stream);
+        if (closed != 0) ok = false;
+    }
+    pthread_mutex_destroy(&capture->lock);
+    pthread_cond_destroy(&capture->changed);
+    if (ok) printf("Captured %zu frames to %s\n", capture->encoded, capture->target);
+    else printf("Can't write captured frames to %s\n", capture->target);
+    return ok;
 }
 
-static void eliminate_auxins(Auxins *auxins, const Veins *veins, const Polygon2 *polygon) {
-    // Collect indeces to remove
-    Indeces to_remove = (Indeces){0};
-    for (size_t i = 0; i < auxins->count; i++) {
-        float min_dist;
-        if (!point_inside(auxins->items[i].center, polygon, &min_dist) || min_dist < (auxins->items[i].radius / 2)) {
-            DA_APPEND((&to_remove), i);
-            continue;
-        }
-        for (size_t j = 0; j < veins->count; j++) {
-            // Take into account that thier might not be a direct path, yet it probably does not matter much
-            if (len_v2(sub_v2(auxins->items[i].center, veins->items[j].center)) <= auxins->items[i].radius &&
-                !segment_intersect_polygon(auxins->items[i].center, veins->items[j].center, polygon)) {
-                DA_APPEND((&to_remove), i);
-                break;
-            }
-        }
+static void draw_growth(const Leafer *leafer) {
+    size_t count;
+    const Vector2 *outline = leafer_outline(leafer, &count);
+    for (size_t i = 0; i < count; i++) {
+        DrawLineEx(outline[i], outline[(i + 1) % count], 3.0f, GREEN);
     }
 
-    // Remove in reverse order using swap with last item and count decrement
-    assert(to_remove.count <= auxins->count && "Attempting to remove more auxins then exist");
-    for (size_t i = to_remove.count; i-- > 0;) {
-        size_t auxin_idx = to_remove.items[i];
-        auxins->items[auxin_idx] = auxins->items[auxins->count - 1];
-        auxins->count--;
+    for (size_t i = 0; i < leafer_node_count(leafer); i++) {
+        LeaferNode node = leafer_node(leafer, i);
+        DrawCircle(node.center.x, node.center.y, node.radius, WHITE);
+        DrawCircle(node.center.x, node.center.y, VEIN_CENTER, BLACK);
     }
-    if (to_remove.items) free(to_remove.items);
 }
 
-static void associate_auxins(Auxins *auxins, Veins *veins, const Polygon2 *polygon) {
-    // Clear previous closest sources
-    for (size_t i = 0; i < veins->count; i++) {
-        veins->items[i].closest_source_indeces.count = 0;
-    }
-
-    // Find closest node for each auxin
-    Indeces to_remove = (Indeces){0};
-    for (size_t i = 0; i < auxins->count; i++) {
-        float min_dist = __FLT_MAX__;
-        auxins->items[i].closest_node_index = veins->count;
-        for (size_t j = 0; j < veins->count; j++) {
-            float dist = len_v2(sub_v2(auxins->items[i].center, veins->items[j].center));
-            if (min_dist > dist &&
-                // Thier might not be direct path
-                !segment_intersect_polygon(auxins->items[i].center, veins->items[j].center, polygon)) {
-                min_dist = dist;
-                auxins->items[i].closest_node_index = j;
-            }
-        }
-
-        // Remove auxins that have no direct path to any vein node
-        if (auxins->items[i].closest_node_index >= veins->count)
-            DA_APPEND((&to_remove), i);
+// Finished leaf: blade, outline and veins, either smoothed or as grown
+static void draw_leaf(const Leafer *leafer, const LeaferTriangles *triangles, const LeaferTree *tree) {
+    for (size_t i = 0; i < triangles->count; i++) {
+        const LeaferTriangle *t = &triangles->items[i];
+        DrawTriangle(t->a, t->b, t->c, LEAFER_COLOR_FILL);
     }
 
-    // Remove in reverse order using swap with last item and count decrement
-    assert(to_remove.count <= auxins->count && "Attempting to remove more auxins then exist");
-    for (size_t i = to_remove.count; i-- > 0;) {
-        size_t auxin_idx = to_remove.items[i];
-        auxins->items[auxin_idx] = auxins->items[auxins->count - 1];
-        auxins->count--;
+    size_t outline_count;
+    const Vector2 *outline = leafer_outline(leafer, &outline_count);
+    for (size_t i = 0; i < outline_count; i++) {
+        DrawLineEx(outline[i], outline[(i + 1) % outline_count], 3.0f, LEAFER_COLOR_OUTLINE);
     }
-    if (to_remove.items) free(to_remove.items);
 
-    // Associate auxins with correcponding nodes
-    for (size_t i = 0; i < auxins->count; i++) {
-        size_t vein_idx = auxins->items[i].closest_node_index;
-        assert(vein_idx < veins->count && "Invalid auxin leaked into association");
-        DA_APPEND((&veins->items[vein_idx].closest_source_indeces), i);
+    for (size_t i = 0; i < tree->count; i++) {
+        const LeaferBranch *v = &tree->items[i];
+        for (size_t j = 0; j < v->count - 1; j++) {
+            DrawLineEx(v->items[j], v->items[j + 1], v->widths[j], leafer_vein_color(v->widths[j]));
+        }
     }
 }
 
-static Edge2 closest_edge(Vector2 point, const Polygon2 *polygon, float *min_dist) {
-    Edge2 edge = {0};
-    *min_dist = __FLT_MAX__;
+static void draw_progress(const char *what, LeaferProgress *progress, int x, int y, int width) {
+    size_t total = atomic_load(&progress->total);
+    size_t done = atomic_load(&progress->done);
+    float part = total > 0 ? (float)done / (float)total : 0.0f;
+    DrawText(what, x, y, FONT_SIZE, (Color){ 10, 10, 10, 180 });
+    DrawRectangleLines(x, y + FONT_SIZE + 4, width, FONT_SIZE / 2, (Color){ 10, 10, 10, 180 });
+    DrawRectangle(x, y + FONT_SIZE + 4, (int)(part * width), FONT_SIZE / 2, (Color){ 10, 10, 10, 180 });
+}
 
-    for (size_t i = 0; i < polygon->count; i++) {
-        Vector2 start = polygon->items[i];
-        Vector2 end = polygon->items[(i + 1) % polygon->count];
+// Stored leaf shown in the window. It comes either from an outline and a veins file or from an archive,
+// where triangles are kept along and only the veins need tracing.
+typedef struct View {
+    LeaferArchive *archive; // NULL for a single leaf
+    size_t index;
+    Leafer *leafer;
+    LeaferTriangles triangles;
+    LeaferTree tree;
+    LeaferTree smooth_tree;
+    Camera2D camera; // fits the leaf into the window
+} View;
+
+static void view_free(View *view) {
+    leafer_free_triangles(&view->triangles);
+    leafer_free_tree(&view->tree);
+    leafer_free_tree(&view->smooth_tree);
+    leafer_destroy(view->leafer);
+    view->leafer = NULL;
+}
 
-        float dist = distance_v2(start, end, point, true);
-        if (*min_dist > dist) {
-            *min_dist = dist;
-            edge.a = start;
-            edge.b = end;
-        }
+static bool view_load(View *view, const LeaferParams *params, const char *outline_file, const char *veins_file, int width, int height) {
+    view_free(view);
+    if (view->archive) {
+        LeaferEntry entry;
+        view->leafer = leafer_archive_load(view->archive, view->index);
+        if (!view->leafer || !leafer_archive_entry(view->archive, view->index, &entry)) return false;
+        for (size_t i = 0; i < entry.triangle_count; i++) DA_APPEND(&view->triangles, entry.triangles[i]);
+    } else {
+        view->leafer = leafer_create(params, (Vector2){0, 0}, 0);
+        if (!leafer_read_outline(view->leafer, outline_file) || !leafer_read_veins(view->leafer, veins_file)) return false;
+        if (!leafer_triangulate(view->leafer, &view->triangles, NULL)) return false;
     }
+    if (!leafer_trace(view->leafer, &view->tree, &view->smooth_tree, NULL)) return false;
 
-    return edge;
+    size_t count;
+    const Vector2 *outline = leafer_outline(view->leafer, &count);
+    Vector2 lo = outline[0], hi = outline[0];
+    for (size_t i = 1; i < count; i++) {
+        lo = (Vector2){fminf(lo.x, outline[i].x), fminf(lo.y, outline[i].y)};
+        hi = (Vector2){fmaxf(hi.x, outline[i].x), fmaxf(hi.y, outline[i].y)};
+    }
+    float zoom = fminf(width / (1.1f * (hi.x - lo.x)), (height - 2 * FONT_SIZE) / (1.1f * (hi.y - lo.y)));
+    view->camera = (Camera2D){
+        .offset=(Vector2){width / 2.0f, (height + 2 * FONT_SIZE) / 2.0f},
+        .target=(Vector2){(lo.x + hi.x) / 2, (lo.y + hi.y) / 2},
+        .zoom=zoom,
+    };
+    return true;
 }
 
-static void produce_new_nodes(const Auxins *auxins, const Polygon2 *polygon, Veins *veins, size_t gen) {
-    // Indices of veins to be processed
-    Indeces to_process = (Indeces){0};
-    for (size_t i = 0; i < veins->count; i++) {
-        const Node *node = &veins->items[i];
-        // Skip nodes with no connections
-        if (node->closest_source_indeces.count == 0) continue;
-        DA_APPEND(&to_process, i);
-    }
-
-    // Indices of veins that have sources pulling them (sorted in descending order of magnitude)
-    Indeces to_duplicate = (Indeces){0};
-    while (to_process.count > 0) {
-        // Find maximum magnitude
-        size_t max_connections = 0;
-        for (size_t k = 0; k < to_process.count; k++) {
-            size_t i = to_process.items[k];
-            if (veins->items[i].closest_source_indeces.count > max_connections)
-                max_connections = veins->items[i].closest_source_indeces.count;
-        }
-        // Move nodes with maximum magnitude to array for further duplication
-        for (size_t k = 0; k < to_process.count;) {
-            size_t i = to_process.items[k];
-            if (veins->items[i].closest_source_indeces.count == max_connections) {
-                DA_APPEND(&to_duplicate, i);
-                // processed - delete
-                assert(to_process.count > 0 && "Attempting to remove from an empty array");
-                to_process.items[k] = to_process.items[to_process.count - 1];
-                to_process.count--;
-            } else {
-                k++;
-            }
+// Window going through stored leaves, arrows page through an archive
+static int run_view(const char *file_name, const char *veins_file, const LeaferParams *params) {
+    View view = (View){0};
+    size_t count = 1;
+    if (!veins_file) {
+        view.archive = leafer_archive_map(file_name);
+        if (!view.archive) return 1;
+        count = leafer_archive_count(view.archive);
+        if (count == 0) {
+            printf("Archive has no leaves: %s\n", file_name);
+            leafer_archive_close(view.archive);
+            return 1;
         }
     }
-    if (to_process.items) free(to_process.items);
 
-    // Duplicate nodes in descending order by their pulling force.
-    for (size_t k = 0; k < to_duplicate.count; k++) {
-        size_t i = to_duplicate.items[k];
-        const Node *parent = &veins->items[i];
+    InitWindow(WIDTH, HEIGHT, "Leafer");
+    SetTargetFPS(60);
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+    bool loaded = view_load(&view, params, file_name, veins_file, width, height);
+    bool showSmoothed = true;
+    char status[128];
+    while (!WindowShouldClose()) {
+        if (IsKeyPressed(KEY_SPACE)) showSmoothed = !showSmoothed;
+        size_t index = view.index;
+        if (IsKeyPressed(KEY_RIGHT) && view.index + 1 < count) view.index++;
+        if (IsKeyPressed(KEY_LEFT) && view.index > 0) view.index--;
+        if (index != view.index) loaded = view_load(&view, params, file_name, veins_file, width, height);
 
-        // Calculate normalized sum
-        Vector2 normalized_sum = (Vector2){0};
-        for (size_t j = 0; j < parent->closest_source_indeces.count; j++) {
-            size_t auxin_idx = parent->closest_source_indeces.items[j];
-            normalized_sum = add_v2(normalized_sum, norm_v2(sub_v2(auxins->items[auxin_idx].center, parent->center)));
-        }
-        normalized_sum = norm_v2(normalized_sum); // Final normalization
-
-        float new_radius = parent->radius * (float)parent->gen / (float)gen;
-        if (new_radius < VEIN_RADIUS_MIN) new_radius = VEIN_RADIUS_MIN;
-
-        // Add new vein node
-        Vector2 new_center = add_v2(parent->center, scale_v2(normalized_sum, parent->radius + new_radius));
-
-        // Check if new node fits in
-        // Becuase nodes are sorted, this process always favours those with more sources attached
-        // Against edges
-        float min_dist;
-        Edge2 closest = closest_edge(new_center, polygon, &min_dist);
-        if (min_dist < (TOLERATION_RATIO * new_radius)) continue;
-        // Against other nodes
-        bool fits = true;
-        for (size_t j = 0; j < veins->count; j++) {
-            float cent_dist = len_v2(sub_v2(new_center, veins->items[j].center));
-            if (cent_dist < (TOLERATION_RATIO * ((float)new_radius + veins->items[j].radius))) {
-                fits = false;
-                break;
-            }
+        BeginDrawing();
+        ClearBackground(LIGHTGRAY);
+        if (loaded) {
+            BeginMode2D(view.camera);
+            draw_leaf(view.leafer, &view.triangles, showSmoothed ? &view.smooth_tree : &view.tree);
+            EndMode2D();
         }
-        if (!fits) continue;
-
-        DA_APPEND(veins, ((Node){.center=new_center, .radius=new_radius, .closest_source_indeces=(Indeces){0}, .parent=parent->center, .gen=gen}));
+        snprintf(status, sizeof(status), "Leaf %zu of %zu%s. Space to enable/disable pattern smoothing, arrows to page",
+                 view.index + 1, count, loaded ? "" : " can't be read");
+        DrawText(status, 10, 10, 2 * FONT_SIZE / 3, (Color){ 120, 120, 120, 255 });
+        EndDrawing();
     }
-    if (to_duplicate.items) free(to_duplicate.items);
-}
 
-static void construct_vertices(Vertices *vertices, const Polygon2 *polygon) {
-    size_t points_count = polygon->count;
-    Vector2 *points = malloc(points_count * sizeof(Vector2));
-    memcpy(points, polygon->items, points_count * sizeof(Vector2));
-
-    size_t i = 0;
-    while (points_count > 3) {
-        Vector2 curr = points[i];
-        Vector2 next = points[(i + 1) % points_count];
-        Vector2 prev = points[(i == 0 ? points_count - 1 : i - 1)];
-        // Ear Clipping: test if the edge from neighboring points inside the polygon
-        Vector2 test_edge = sub_v2(prev, next);
-        Vector2 test_point = {next.x + test_edge.x / 2, next.y + test_edge.y / 2};
-        float min_dist;
-        if (point_inside(test_point, polygon, &min_dist) && !segment_intersect_polygon(next, prev, polygon)) {
-            assert(min_dist < __FLT_MAX__ && "A point inside the shape should have finite minimal distance");
-            float cross = cross_v2(sub_v2(next, curr), sub_v2(prev, curr));
-            Triangle2 t = (cross < 0 ? (Triangle2){curr, next, prev} : (Triangle2){curr, prev, next});
-            DA_APPEND(vertices, t);
-
-            // Remove curr point without re-shuffle, sadge
-            for (size_t j = i; j < points_count - 1; j++) {
-                points[j] = points[j + 1];
-            }
-            points_count--;
-        } else {
-            i++;
-        }
-        // Rotate index around
-        i = i % points_count;
-    }
-    // And last triangle
-    Vector2 curr = points[0];
-    Vector2 next = points[1];
-    Vector2 prev = points[2];
-    float cross = cross_v2(sub_v2(next, curr), sub_v2(prev, curr));
-    Triangle2 t = (cross < 0 ? (Triangle2){curr, next, prev} : (Triangle2){curr, prev, next});
-    DA_APPEND(vertices, t);
-    free(points);
+    CloseWindow();
+    view_free(&view);
+    leafer_archive_close(view.archive);
+    return loaded ? 0 : 1;
 }
 
-static Node* node_by_parent(const Veins *veins, Vector2 parent) {
-    for (size_t i = 0; i < veins->count; i++) {
-        if (same_v2(parent, veins->items[i].center)) return &veins->items[i]; 
+// Density map in any format raylib reads, turned to grayscale
+static bool load_density(Image *image, const char *file_name) {
+    *image = LoadImage(file_name);
+    if (!image->data) {
+        printf("Can't read density map: %s\n", file_name);
+        return false;
     }
-    printf("parent: (%.3f, %.3f)\n", parent.x, parent.y);
-    assert(!"Unreacheble");
+    ImageFormat(image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+    return true;
 }
 
-// Traverse vein nodes and create tree structure
-static void traverse_parents(const Veins *veins, Vector2 root, Tree *tree, Tree *smoothTree) {
-    Indeces leaves = (Indeces){0};
-    for (size_t i = 0; i < veins->count; i++) {
-        bool used_as_parent = false;
-        const Node *node = &veins->items[i];
-        for (size_t j = 0; j < veins->count; j++) {
-            if (same_v2(veins->items[j].parent, node->center)) {
-                used_as_parent = true;
-                break;
-            }
-        }
-        if (!used_as_parent) DA_APPEND(&leaves, i);
-    }
+static void usage(const char *program) {
+    printf("Usage: %s [--growth-rate <rate>] [--frame-budget <ms>] [--simplify <area>] [--density <image>] [--archive <file>] [--capture <target>] [--view <archive> | --view <outline> <veins>] [--batch <manifest> [--jobs <threads>] [--out <dir>] [--svg] [--glb] [--png <width>] [--spill] [--compact]]\n", program);
+    printf("    Without arguments opens a window to draw and grow a single leaf\n");
+    printf("    --growth-rate  expand the blade by this fraction each step while veins grow\n");
+    printf("    --frame-budget milliseconds of growth per frame of the window, 12 by default\n");
+    printf("    --simplify     drop points of smoothed veins spanning less area, 0 keeps all\n");
+    printf("    --view         look through stored leaves instead of growing one, arrows page through an archive\n");
+    printf("    --density      grayscale image over the blade's bounding box, brighter parts get more auxins\n");
+    printf("    --capture      record growth one frame per step: PNG frames into a directory, Y4M into a .y4m file or a command after |\n");
+    printf("    --archive      append every finished leaf to this archive, batches write no veins and vertices files then\n");
+    printf("    --batch  grow every leaf listed in the manifest without a window,\n");
+    printf("             one job per line: <outline file> <seed> [name=value ...]\n");
+    printf("    --jobs   number of worker threads, all cores by default\n");
+    printf("    --out    directory for the results, current one by default\n");
+    printf("    --svg    also export every leaf as SVG\n");
+    printf("    --glb    also export every leaf as binary glTF mesh\n");
+    printf("    --png    also render every leaf on CPU into a PNG of given width\n");
+    printf("    --spill  grow out of core: finished tiles of the leaf are moved to disk\n");
+    printf("    --compact  write veins quantised and delta encoded, about an eighth of the size\n");
+}
 
-    for (size_t i = 0; i < leaves.count; i++) {
-        // Traverse from leaf to root
-        Branch branch = (Branch){0};
-        Node *node = &veins->items[leaves.items[i]];
-        DA_APPEND(&branch, node->center);
-        while (!same_v2(node->parent, (Vector2){-1, -1})) {
-            node = node_by_parent(veins, node->parent);
-            DA_APPEND((&branch), node->center);
+int main(int argc, char **argv) {
+    const char *manifest = NULL;
+    const char *archive_file = NULL;
+    const char *view_file = NULL;
+    const char *capture_target = NULL;
+    const char *density_file = NULL;
+    const char *view_veins = NULL;
+    Batch batch = {.out_dir="."};
+    size_t threads_count = 0;
+    double frame_budget = FRAME_BUDGET_MS;
+    LeaferParams params = leafer_default_params();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) manifest = argv[++i];
+        else if (strcmp(argv[i], "--growth-rate") == 0 && i + 1 < argc) params.growth_rate = strtof(argv[++i], NULL);
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc) frame_budget = strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--simplify") == 0 && i + 1 < argc) params.simplify_veins = strtof(argv[++i], NULL);
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) threads_count = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) batch.out_dir = argv[++i];
+        else if (strcmp(argv[i], "--svg") == 0) batch.svg = true;
+        else if (strcmp(argv[i], "--glb") == 0) batch.glb = true;
+        else if (strcmp(argv[i], "--png") == 0 && i + 1 < argc) batch.png_width = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--spill") == 0) batch.spill = true;
+        else if (strcmp(argv[i], "--compact") == 0) batch.compact = true;
+        else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) archive_file = argv[++i];
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture_target = argv[++i];
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc) density_file = argv[++i];
+        else if (strcmp(argv[i], "--view") == 0 && i + 1 < argc) {
+            view_file = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) view_veins = argv[++i];
         }
-        // Finish branch with the root point
-        DA_APPEND((&branch), root);
-
-        // Add un-smoothed branch to a tree - copy data to avoid corruption later
-        Branch tmp = (Branch){0};
-        tmp.count = branch.count;
-        tmp.capacity = branch.count; // no need to waste mem
-        tmp.items = malloc(sizeof(*tmp.items) * tmp.capacity);
-        memcpy(tmp.items, branch.items, sizeof(*tmp.items) * tmp.count);
-        DA_APPEND(tree, tmp);
-
-        // Smooth resulting polyline: Chaikin’s Method
-        for (size_t n = 0; n < SMOOTH_ITERATION; n++) {
-            bool anySplitted = false;
-            // Swap items and fill 'branch' with smothed version
-            tmp.count = branch.count;
-            tmp.capacity = branch.capacity;
-            tmp.items = branch.items;
-            branch = (Branch){0};
-            for (size_t i = 0; i < tmp.count - 1; i++) {
-                Vector2 a = tmp.items[i];
-                Vector2 b = tmp.items[i + 1];
-
-                Vector2 ab = sub_v2(b, a);
-                if (len_v2(ab) > MIN_POLYGON_LEN) {
-                    Vector2 m1 = (Vector2){a.x + ab.x * (1 - SMOOTH_RATIO), a.y + ab.y * (1 - SMOOTH_RATIO)};
-                    Vector2 m2 = (Vector2){a.x + ab.x * SMOOTH_RATIO,       a.y + ab.y * SMOOTH_RATIO};
-                    if (i == 0) DA_APPEND((&branch), a);    // to preserve original end point of a branch
-                    DA_APPEND((&branch), m1);
-                    DA_APPEND((&branch), m2);
-                    anySplitted = true;
-                } else {
-                    DA_APPEND((&branch), a);
-                    DA_APPEND((&branch), b);
-                }
-            }
-            DA_APPEND((&branch), tmp.items[tmp.count - 1]); // to preserve original start (root) point of a branch
-            free(tmp.items);
-
-            // avoid unnecessary work
-            if (!anySplitted) break;
+        else {
+            usage(argv[0]);
+            return 1;
         }
-        // Add smoothed branch to a tree
-        DA_APPEND(smoothTree, branch);
     }
+    Image density = (Image){0};
+    if (density_file && !load_density(&density, density_file)) return 1;
+    if (manifest) {
+        batch.density = density_file ? &density : NULL;
+        int result = run_batch(manifest, &batch, threads_count, archive_file);
+        UnloadImage(density);
+        return result;
+    }
+    if (view_file) return run_view(view_file, view_veins, &params);
 
-    free(leaves.items);
-}
-
-int main(void) {
     InitWindow(WIDTH, HEIGHT, "Leafer");
     SetTargetFPS(60);
     unsigned int seed_val = GetRandomValue(0, 0x7FFFFFFF);
     printf("Seed: %d\n", seed_val);
-    SetRandomSeed(seed_val);
 
     int width = GetScreenWidth();
     int height = GetScreenHeight();
     Stage current_stage = DRAWING;
 
-    Vector2 seed_coord = {(float)width / 2, height - 4 * VEIN_RADIUS};
+    Vector2 seed_coord = {(float)width / 2, height - 4 * params.vein_radius};
 
-    Polygon2 polygon = (Polygon2){0};
-    polygon.closed = false;
-    DA_APPEND(&polygon, ((Vector2){seed_coord.x, seed_coord.y + 3 * VEIN_RADIUS}));
+    Leafer *leafer = leafer_create(&params, seed_coord, seed_val);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    leafer_set_threads(leafer, cores > 0 ? (size_t)cores : 1);
+    if (density_file && !leafer_set_density(leafer, density.data, density.width, density.height)) return 1;
+    UnloadImage(density);
 
-    Veins veins = (Veins){0};
+    Finishing finishing = (Finishing){0};
+    const LeaferTriangles *triangles = &finishing.triangles;
+    const LeaferTree *tree = &finishing.tree;
+    const LeaferTree *smoothTree = &finishing.smooth_tree;
+
+    Drawing draw_state = drawing_init(width, height);
+    Capture capture;
+    bool capturing = false;
 
-    // Several first nodes
-    size_t gen = GEN_START;
-    Node vein1 = {
-        .center=(Vector2){seed_coord.x, seed_coord.y + VEIN_RADIUS},
-        .radius=VEIN_RADIUS,
-        .closest_source_indeces=(Indeces){0},
-        .parent=(Vector2){-1,-1},
-        .gen=gen++,
-    };
-    DA_APPEND(&veins, vein1);
-
-    Node vein2 = {
-        .center=(Vector2){seed_coord.x, seed_coord.y - VEIN_RADIUS},
-        .radius=VEIN_RADIUS,
-        .closest_source_indeces=(Indeces){0},
-        .parent=veins.items[0].center,
-        .gen=gen++,
-    };
-    DA_APPEND(&veins, vein2);
-
-    Auxins auxins = (Auxins){0};
-    Vertices vertices = (Vertices){0};
-    Tree tree = (Tree){0};
-    Tree smoothTree = (Tree){0};
-
-    // define set of global vars
-    hint1_x = (width - strlen(hint1) * FONT_SIZE / 2) / 2;
-    hint1_y = height / 3 - FONT_SIZE;
-    hint2_x = (width - strlen(hint2) * FONT_SIZE / 2) / 2;
-    hint2_y = height / 3;
-    hint3_x = (width - strlen(hint3) * FONT_SIZE / 2) / 2;
-    hint3_y = height / 3 + FONT_SIZE;
-    hint4_x = (width - strlen(hint4) * FONT_SIZE) / 2;
-    hint4_y = height / 3 + 4 * FONT_SIZE;
-
-    size_t prev_veins_count = veins.count;
-    int attemps_count = FINAL_ATTEMPS;
     bool showSmoothed = true;
     while (!WindowShouldClose()) {
         BeginDrawing();
 
         switch (current_stage) {
             case DRAWING: {
-                if (drawing(&polygon, seed_coord, width, height)) {
-                    if (!write_polygon_file(&polygon, "polygon_out.bin")) return 1;
-                    polygon.closed = true;
+                if (drawing(&draw_state, leafer, seed_coord, 2 * params.vein_radius, width, height)) {
+                    if (!leafer_write_outline(leafer, "polygon_out.bin")) return 1;
+                    leafer_start(leafer, NULL);
+                    if (capture_target) capturing = capture_start(&capture, capture_target);
                     current_stage = GROWING;
                 }
             } break;
             case GROWING: {
-                ClearBackground(LIGHTGRAY);
-
-                for (size_t i = 0; i < polygon.count; i++) {
-                    DrawLineEx(polygon.items[i], polygon.items[(i + 1) % polygon.count], 3.0f, GREEN);
-                }
+                // Captured growth gets one frame per step however long the step takes
+                bool stopped = capturing ? leafer_step(leafer) : leafer_advance(leafer, leafer_now() + frame_budget / 1000.0);
 
-                for (size_t i = 0; i < veins.count; i++) {
-                    DrawCircle(veins.items[i].center.x, veins.items[i].center.y, veins.items[i].radius, WHITE);
-                    DrawCircle(veins.items[i].center.x, veins.items[i].center.y, VEIN_CENTER, BLACK);
-                }
-
-                // 1. If number of auxin is lower then spray threshold -> spray more
-                spray_auxins(&auxins, &polygon, width, height);
-
-                // 2. Remove auxins which radius fits in any vein's center, draw them after
-                eliminate_auxins(&auxins, &veins, &polygon);
+                ClearBackground(LIGHTGRAY);
+                draw_growth(leafer);
 
-                for (size_t i = 0; i < auxins.count; i++) {
-                    DrawCircle(auxins.items[i].center.x, auxins.items[i].center.y, AUXIN_DOT_RADIUS, PINK);
-                    DrawRing(auxins.items[i].center, auxins.items[i].radius, auxins.items[i].radius + 1, 0, 360, 200, PINK);
+                for (size_t i = 0; i < leafer_auxin_slots(leafer); i++) {
+                    LeaferAuxin auxin;
+                    if (!leafer_auxin(leafer, i, &auxin)) continue;
+                    DrawCircle(auxin.center.x, auxin.center.y, AUXIN_DOT_RADIUS, PINK);
+                    DrawRing(auxin.center, auxin.radius, auxin.radius + 1, 0, 360, 200, PINK);
                 }
 
-                // 3. Associate each auxin with vein node that is closes to it
-                associate_auxins(&auxins, &veins, &polygon);
-
-                // 4. Construct normalized vectors from the vein node to each associated auzin source.
-                // Sum constructed vectors and normalize it again -> calculate location of new node and add them
-                produce_new_nodes(&auxins, &polygon, &veins, gen);
-
-                // At some point the growth stops, move to next stage after certain amount of last attempts
-                if (prev_veins_count == veins.count) {
-                    if (--attemps_count) {
-                        write_veins_file(&veins, "veins_out.bin");
-                        printf("Constructing vertices\n");
-                        construct_vertices(&vertices, &polygon);
-                        printf("Traversing parents\n");
-                        traverse_parents(&veins, polygon.items[0], &tree, &smoothTree);
-                        current_stage = STOPPED;
-                        break; // break of the switch
-                    }
-                } else {
-                    prev_veins_count = veins.count;
-                    attemps_count = FINAL_ATTEMPS;
-                    gen++;
+                if (capturing) capture_frame(&capture);
+                if (stopped) {
+                    if (capturing) capture_stop(&capture);
+                    capturing = false;
+                    leafer_report(leafer, "Growth");
+                    finishing_start(&finishing, leafer, archive_file, seed_val);
+                    current_stage = FINISHING;
                 }
             } break;
+            case FINISHING: {
+                ClearBackground(LIGHTGRAY);
+                draw_growth(leafer);
+                draw_progress("Triangulating blade", &finishing.triangulation, 10, 10, width / 3);
+                draw_progress("Tracing veins", &finishing.tracing, 10, 20 + 2 * FONT_SIZE, width / 3);
+                if (finishing_poll(&finishing)) current_stage = STOPPED;
+            } break;
             case STOPPED: {
                 if (IsKeyPressed(KEY_SPACE)) showSmoothed = !showSmoothed;
 
                 ClearBackground(LIGHTGRAY);
                 DrawText("Space to enable/disable pattern smoothing", 10, 10, 2 * FONT_SIZE / 3, (Color){ 120, 120, 120, 255 });
-
-                for (size_t i = 0; i < vertices.count; i++) {
-                    const Triangle2 *t = &vertices.items[i];
-                    DrawTriangle(t->a, t->b, t->c, LEAF_COLOR_FILL);
+                if (!atomic_load(&finishing.exported)) {
+                    DrawText("Saving mesh...", 10, 10 + FONT_SIZE, 2 * FONT_SIZE / 3, (Color){ 120, 120, 120, 255 });
                 }
 
-                for (size_t i = 0; i < polygon.count; i++) {
-                    DrawLineEx(polygon.items[i], polygon.items[(i + 1) % polygon.count], 3.0f, LEAF_COLOR_OUTLINE);
-                }
-
-                for (size_t i = 0; i < tree.count; i++) {
-                    const Branch *v = (showSmoothed) ? &smoothTree.items[i] : &tree.items[i];
-                    for (size_t j = 0; j < v->count - 1; j++) {
-                        float t = (float)j / (float)v->count;
-                        float thickness = LEAF_VEIN_THCK_START + (LEAF_VEIN_THCK_END - LEAF_VEIN_THCK_START) * t;
-                        Color color = lerp_color(LEAF_COLOR_VEIN1, LEAF_COLOR_VEIN2, t);
-                        DrawLineEx(v->items[j], v->items[j + 1], thickness, color);
-                    }
-                }
+                draw_leaf(leafer, triangles, showSmoothed ? smoothTree : tree);
             } break;
         }
 
         EndDrawing();
     }
 
+    if (capturing) capture_stop(&capture);
     CloseWindow();
+    finishing_free(&finishing);
+    leafer_destroy(leafer);
     return 0;
-}
\ No newline at end of file
+}